@@ -0,0 +1,39 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef ChordBitmask_h
+#define ChordBitmask_h
+
+/**
+ * Packs a chord matrix into a bitmask,
+ * with the key at [row][column] stored in bit (row * COLS + column).
+ */
+inline unsigned long chordToBitmask(const boolean (&chord)[ROWS][COLS]) {
+  unsigned long bitmask = 0;
+  for (int row = 0; row < ROWS; row++) {
+    for (int column = 0; column < COLS; column++) {
+      if (chord[row][column]) {
+        bitmask |= 1UL << (row * COLS + column);
+      }
+    }
+  }
+  return bitmask;
+}
+
+#endif // ChordBitmask_h
@@ -0,0 +1,36 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef Crc8_h
+#define Crc8_h
+
+#include <stdint.h>
+
+/**
+ * Updates a CRC-8 (polynomial 0x07, initial value 0) with one more byte.
+ */
+inline uint8_t crc8Update(uint8_t crc, const uint8_t data) {
+  crc ^= data;
+  for (int bit = 0; bit < 8; bit++) {
+    crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x07) : (uint8_t) (crc << 1);
+  }
+  return crc;
+}
+
+#endif // Crc8_h
@@ -32,7 +32,7 @@ public:
 //    Serial.begin(9600);
 //  }
 
-  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS]) const {
+  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS], const unsigned long strokeMicros) const {
     // Initialize chord bytes
     byte chordBytes[] = {B10000000, B0, B0, B0, B0, B0};
 
@@ -121,6 +121,7 @@ public:
     for (int i = 0; i < 6; i++) {
       Serial.write(chordBytes[i]);
     }
+    strokeSent(strokeMicros);
   }
 };
 
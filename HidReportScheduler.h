@@ -0,0 +1,215 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef HidReportScheduler_h
+#define HidReportScheduler_h
+
+#include <Keyboard.h>
+#include "Protocol.h"
+
+/**
+ * Room for two strokes with every key pressed and released on its own,
+ * plus two more reports each, like the release all of every protocol. A stroke split off while
+ * the previous one is still queued then never overflows the queue,
+ * so reports are always spread one per frame.
+ */
+#define HID_REPORT_QUEUE_SIZE (2 * (2 * ROWS * COLS + 2))
+#define HID_STROKE_QUEUE_SIZE 8
+
+/**
+ * Returns the number of the current USB frame, which increments every 1 ms.
+ * On boards without a readable frame number, millis() is used instead.
+ */
+inline byte usbFrameNumber() {
+#ifdef UDFNUML
+  return UDFNUML;
+#else
+  return (byte) millis();
+#endif
+}
+
+/**
+ * Queues keyboard emulation key presses and releases,
+ * and sends at most one of them per USB frame.
+ *
+ * Every press and release is a HID report of its own.
+ * The HID endpoint of the Arduino keyboard library is already polled
+ * every 1 ms, but reports written in quicker succession are coalesced
+ * or dropped by some hosts, so they are spread out over frames here.
+ *
+ * The frame clock and the time source are passed in,
+ * so the scheduler can run on mocked clocks as well.
+ */
+class HidReportScheduler {
+
+  enum Action { PRESS, RELEASE, RELEASE_ALL };
+  /** Set on the action of the last report of a stroke */
+  static const byte STROKE_END = 0x80;
+
+  struct Report {
+    byte action;
+    byte key;
+    /** Lower 16 bits of the time source when queued */
+    unsigned int queuedMicros;
+  };
+
+  byte (* const frameClock)();
+  unsigned long (* const clock)();
+  Report queue[HID_REPORT_QUEUE_SIZE];
+  byte head;
+  byte count;
+  byte lastFrame;
+  /** Finish times of the strokes with reports in the queue, oldest first */
+  unsigned long strokeEndMicros[HID_STROKE_QUEUE_SIZE];
+  byte strokeHead;
+  byte strokeCount;
+  StrokeSentListener strokeSentListener;
+
+  void notifyStrokeSent(const unsigned long strokeMicros) {
+    if (strokeSentListener != 0) {
+      strokeSentListener(strokeMicros);
+    }
+  }
+
+  void enqueue(const byte action, const byte key) {
+    if (count == HID_REPORT_QUEUE_SIZE) {
+      // Only after more than two strokes queued up.
+      // Rather send a report early, coalesced with the last one, than lose it
+      overflows++;
+      sendNext();
+    }
+    Report& report = queue[(head + count) % HID_REPORT_QUEUE_SIZE];
+    report.action = action;
+    report.key = key;
+    report.queuedMicros = (unsigned int) clock();
+    count++;
+  }
+
+  void sendNext() {
+    const Report& report = queue[head];
+    switch (report.action & ~STROKE_END) {
+    case PRESS:
+      Keyboard.press(report.key);
+      break;
+    case RELEASE:
+      Keyboard.release(report.key);
+      break;
+    case RELEASE_ALL:
+      Keyboard.releaseAll();
+      break;
+    }
+    const unsigned int delayMicros = (unsigned int) clock() - report.queuedMicros;
+    if (delayMicros > maxDelayMicros) {
+      maxDelayMicros = delayMicros;
+    }
+    totalDelayMicros += delayMicros;
+    sentReports++;
+    if (report.action & STROKE_END) {
+      const unsigned long strokeMicros = strokeEndMicros[strokeHead];
+      strokeHead = (strokeHead + 1) % HID_STROKE_QUEUE_SIZE;
+      strokeCount--;
+      notifyStrokeSent(strokeMicros);
+    }
+    head = (head + 1) % HID_REPORT_QUEUE_SIZE;
+    count--;
+  }
+
+public:
+
+  /** Number of reports sent */
+  unsigned long sentReports;
+  /** Sum of the queueing delays of all sent reports */
+  unsigned long totalDelayMicros;
+  /** Longest queueing delay of a sent report */
+  unsigned int maxDelayMicros;
+  /** Number of reports sent early because the queue was full */
+  unsigned int overflows;
+
+  /**
+   * @param frameClock returns the number of the current USB frame
+   * @param clock returns the current time in microseconds
+   */
+  HidReportScheduler(byte (*frameClock)() = usbFrameNumber, unsigned long (*clock)() = micros)
+    : frameClock(frameClock), clock(clock), head(0), count(0), lastFrame(0),
+      strokeHead(0), strokeCount(0), strokeSentListener(0)
+  {
+    resetStats();
+  }
+
+  void press(const byte key) {
+    enqueue(PRESS, key);
+  }
+
+  void release(const byte key) {
+    enqueue(RELEASE, key);
+  }
+
+  void releaseAll() {
+    enqueue(RELEASE_ALL, 0);
+  }
+
+  /**
+   * Marks the last queued report as the end of a stroke,
+   * so the stroke sent listener is called once it has been sent.
+   * @param strokeMicros the time the stroke was finished
+   */
+  void endStroke(const unsigned long strokeMicros) {
+    if (count == 0 || strokeCount == HID_STROKE_QUEUE_SIZE) {
+      // Nothing left to wait for, or no room to remember the stroke
+      notifyStrokeSent(strokeMicros);
+      return;
+    }
+    queue[(head + count - 1) % HID_REPORT_QUEUE_SIZE].action |= STROKE_END;
+    strokeEndMicros[(strokeHead + strokeCount) % HID_STROKE_QUEUE_SIZE] = strokeMicros;
+    strokeCount++;
+  }
+
+  void setStrokeSentListener(const StrokeSentListener listener) {
+    strokeSentListener = listener;
+  }
+
+  /**
+   * Sends the next queued report, if a new USB frame has started
+   * since the last one was sent.
+   * Has to be called at least once per frame to keep up.
+   */
+  void update() {
+    const byte frame = frameClock();
+    if (count > 0 && frame != lastFrame) {
+      lastFrame = frame;
+      sendNext();
+    }
+  }
+
+  /**
+   * Returns the average queueing delay of the sent reports.
+   */
+  unsigned long averageDelayMicros() const {
+    return sentReports > 0 ? totalDelayMicros / sentReports : 0;
+  }
+
+  void resetStats() {
+    sentReports = 0;
+    totalDelayMicros = 0;
+    maxDelayMicros = 0;
+    overflows = 0;
+  }
+};
+
+#endif // HidReportScheduler_h
@@ -21,19 +21,25 @@
 #define NKROProtocol_h
 
 #include "Protocol.h"
-#include <Keyboard.h>
+#include "HidReportScheduler.h"
 
 /**
  * Sends the current chord using the NKRO keyboard emulation.
  */
 class NKROProtocol : public Protocol {
+
+  /** Spreads the key press and release reports over USB frames */
+  HidReportScheduler& hidReports;
+
 public:
   
-  NKROProtocol() {
+  NKROProtocol(HidReportScheduler& hidReports)
+    : hidReports(hidReports)
+  {
     Keyboard.begin();
   }
 
-  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS]) const {
+  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS], const unsigned long strokeMicros) const {
     // QWERTY mapping
     char keyMapping[ROWS][COLS] = {
       {'q', 'w', 'e', 'r', 't', ' '},
@@ -58,15 +64,16 @@ public:
     // Emulate keyboard key presses
     for (int key = 0; key < keyCounter; key++) {
       if (pressedKeys[key] != ' ') {
-        Keyboard.press(pressedKeys[key]);
+        hidReports.press(pressedKeys[key]);
         if (!firstKeyPressed) {
           firstKeyPressed = true;
         } else {
-          Keyboard.release(pressedKeys[key]);
+          hidReports.release(pressedKeys[key]);
         }
       }
     }
-    Keyboard.releaseAll();
+    hidReports.releaseAll();
+    hidReports.endStroke(strokeMicros);
   }
 };
 
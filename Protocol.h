@@ -20,10 +20,53 @@
 #ifndef Protocol_h
 #define Protocol_h
 
+/**
+ * Is called once a stroke has actually been sent,
+ * with the time the stroke was finished, see StenoEngine::strokeMicros.
+ */
+typedef void (*StrokeSentListener)(const unsigned long strokeMicros);
+
 class Protocol {
+
+  StrokeSentListener strokeSentListener;
+
+protected:
+
+  /**
+   * Has to be called by implementations once a stroke has actually been sent.
+   */
+  void strokeSent(const unsigned long strokeMicros) const {
+    if (strokeSentListener != 0) {
+      strokeSentListener(strokeMicros);
+    }
+  }
+
 public:
 
-  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS]) const = 0;
+  Protocol()
+    : strokeSentListener(0)
+  {}
+
+  /**
+   * @param strokeMicros the time the stroke was finished,
+   *   to be passed on to strokeSent() once it has actually been sent
+   */
+  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS], const unsigned long strokeMicros) const = 0;
+
+  /**
+   * Is called on every loop iteration,
+   * for protocols that have to send data independently of new chords.
+   */
+  virtual void update() {}
+
+  /**
+   * Sends everything still held back, before switching to another protocol.
+   */
+  virtual void flush() {}
+
+  void setStrokeSentListener(const StrokeSentListener listener) {
+    strokeSentListener = listener;
+  }
 };
 
 #endif // Protocol_h
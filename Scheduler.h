@@ -0,0 +1,132 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef Scheduler_h
+#define Scheduler_h
+
+/**
+ * A periodic firmware task, run cooperatively by the Scheduler.
+ * Tasks are described in a static table, and identified by their index in it.
+ */
+struct Task {
+  void (*run)();
+  /** Time between two releases of the task */
+  unsigned long periodMicros;
+  /** Time after its release by which a run has to be finished */
+  unsigned long deadlineMicros;
+  /** Lower values run first when several tasks are due */
+  int priority;
+};
+
+/**
+ * The runtime state and statistics of a Task, maintained by the Scheduler.
+ */
+struct TaskState {
+  unsigned long releaseMicros;
+  unsigned long runs;
+  unsigned int overruns;
+  unsigned long maxRunMicros;
+};
+
+/**
+ * Runs a static table of tasks cooperatively,
+ * by order of priority and at most one per call of runNext(),
+ * so the time between two key scans is bounded by the longest task.
+ * Tasks finishing after their deadline are counted as overruns.
+ *
+ * The clock is passed in, so the scheduler can run on micros()
+ * as well as on a virtual clock.
+ */
+class Scheduler {
+
+  const Task* const tasks;
+  TaskState* const states;
+  const int taskCount;
+  unsigned long (* const clock)();
+
+public:
+
+  /**
+   * @param states has to hold one entry per task
+   */
+  Scheduler(const Task* tasks, TaskState* states, const int taskCount, unsigned long (*clock)())
+    : tasks(tasks), states(states), taskCount(taskCount), clock(clock)
+  {}
+
+  /**
+   * Releases all tasks for the first time, now, and resets their statistics.
+   */
+  void begin() {
+    const unsigned long nowMicros = clock();
+    for (int i = 0; i < taskCount; i++) {
+      states[i].releaseMicros = nowMicros;
+      states[i].runs = 0;
+      states[i].overruns = 0;
+      states[i].maxRunMicros = 0;
+    }
+  }
+
+  /**
+   * Runs the due task with the highest priority, if any.
+   * @return false if no task was due
+   */
+  boolean runNext() {
+    const unsigned long nowMicros = clock();
+    int next = -1;
+    for (int i = 0; i < taskCount; i++) {
+      if ((long) (nowMicros - states[i].releaseMicros) >= 0
+          && (next < 0 || tasks[i].priority < tasks[next].priority)) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      return false;
+    }
+
+    const Task& task = tasks[next];
+    TaskState& state = states[next];
+    const unsigned long startMicros = clock();
+    task.run();
+    const unsigned long endMicros = clock();
+
+    state.runs++;
+    if (endMicros - startMicros > state.maxRunMicros) {
+      state.maxRunMicros = endMicros - startMicros;
+    }
+    if (endMicros - state.releaseMicros > task.deadlineMicros && state.overruns < 0xFFFF) {
+      state.overruns++;
+    }
+    state.releaseMicros += task.periodMicros;
+    // If a whole period was missed, realign instead of running a backlog
+    if ((long) (endMicros - state.releaseMicros) >= 0) {
+      state.releaseMicros = endMicros + task.periodMicros;
+    }
+    return true;
+  }
+
+  int getTaskCount() const {
+    return taskCount;
+  }
+
+  const TaskState& getTaskState(const int index) const {
+    return states[index];
+  }
+};
+
+#endif // Scheduler_h
@@ -0,0 +1,200 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef SerialCommandChannel_h
+#define SerialCommandChannel_h
+
+#include "Crc8.h"
+
+/*
+ * Binary command channel on the serial port.
+ *
+ * Frames look the same in both directions:
+ *
+ * byte 0        marker (COMMAND_FRAME_MARKER)
+ * byte 1        command
+ * byte 2        payload length in bytes
+ * payload       command specific, multi byte values are little endian
+ * last byte     CRC-8 (polynomial 0x07) over bytes 1 up to the payload end
+ *
+ * The host only sends commands, so incoming bytes are all commands.
+ * Outgoing frames share the port with the steno protocols. They are only
+ * written in between chord packets, and the marker byte never starts a
+ * Gemini PR packet nor appears in TX Bolt, so hosts can tell them apart.
+ * Stroke batch packets can contain the marker byte in their sequence,
+ * payload and CRC bytes though. With that protocol, hosts have to skip
+ * whole batch packets using their length byte, and only look for the
+ * marker in between packets.
+ *
+ * Replies echo the command with COMMAND_REPLY set, and carry the current
+ * value for both the get and the set commands.
+ */
+
+#define COMMAND_FRAME_MARKER 0xFE
+#define COMMAND_MAX_PAYLOAD 12
+
+#define COMMAND_REPLY 0x80
+
+// Payload: none, reply: protocol id (byte)
+#define COMMAND_GET_PROTOCOL 0x01
+// Payload: protocol id (byte)
+#define COMMAND_SET_PROTOCOL 0x02
+// Payload: none, reply: debounce time in milliseconds (byte)
+#define COMMAND_GET_DEBOUNCE 0x03
+// Payload: debounce time in milliseconds (byte)
+#define COMMAND_SET_DEBOUNCE 0x04
+// Payload: none, reply: minimum time between key scans in microseconds (2 bytes)
+#define COMMAND_GET_SCAN_INTERVAL 0x05
+// Payload: minimum time between key scans in microseconds (2 bytes), 0 scans continuously
+#define COMMAND_SET_SCAN_INTERVAL 0x06
+// Payload: none, reply: emission mode (byte)
+#define COMMAND_GET_EMISSION_MODE 0x07
+// Payload: emission mode (byte)
+#define COMMAND_SET_EMISSION_MODE 0x08
+// Payload: 1 to stream stroke telemetry, 0 to stop
+#define COMMAND_SET_TELEMETRY 0x09
+// Payload: none, reply: average and maximum queueing delay of keyboard
+// emulation reports in microseconds (2 bytes each), reports sent (4 bytes),
+// reports sent early because the queue was full (2 bytes)
+#define COMMAND_GET_HID_STATS 0x0A
+// Payload: none, reply: strokes counted (4 bytes), heavy hitters (byte),
+// followed by one COMMAND_STROKE_STATS_ENTRY frame per heavy hitter
+#define COMMAND_GET_STROKE_STATS 0x0B
+// Payload: none, reply: none
+#define COMMAND_RESET_STROKE_STATS 0x0C
+// Payload: none, reply: number of tasks (byte), followed by one
+// COMMAND_TASK_STATS_ENTRY frame per task, in the order of the task table
+#define COMMAND_GET_TASK_STATS 0x0D
+
+// Sent unrequested for every stroke while telemetry is on.
+// Payload: time from the stroke being finished (see StenoEngine::strokeMicros)
+// until it has actually been sent, in microseconds (4 bytes). That is until
+// its packet has been written to serial, or until its last keyboard
+// emulation report has been sent.
+#define COMMAND_TELEMETRY 0x40
+// Follows the reply to COMMAND_GET_STROKE_STATS. Payload: table index (byte),
+// stroke bitmask (4 bytes), estimated count (2 bytes)
+#define COMMAND_STROKE_STATS_ENTRY 0x41
+// Follows the reply to COMMAND_GET_TASK_STATS. Payload: task index (byte),
+// runs (4 bytes), deadline overruns (2 bytes), longest run in microseconds
+// (2 bytes, saturated)
+#define COMMAND_TASK_STATS_ENTRY 0x42
+// Sent instead of a reply. Payload: command (byte), error code (byte)
+#define COMMAND_ERROR 0x7F
+
+#define COMMAND_ERROR_UNKNOWN_COMMAND 1
+#define COMMAND_ERROR_BAD_PAYLOAD 2
+#define COMMAND_ERROR_BAD_VALUE 3
+
+/** Strokes are sent once all keys have been released */
+#define EMISSION_MODE_ON_RELEASE 0
+/** Overlapping strokes are split, see StenoEngine::rolloverSplitting */
+#define EMISSION_MODE_ROLLOVER 1
+
+/**
+ * Parses incoming command frames one byte at a time, so it never blocks,
+ * and writes outgoing frames.
+ * Frames with a bad CRC or length are dropped.
+ */
+class SerialCommandChannel {
+
+  enum State { MARKER, COMMAND, LENGTH, PAYLOAD, CRC };
+
+  State state;
+  byte crc;
+  byte payloadSize;
+
+public:
+
+  /** Command of the last complete frame */
+  byte command;
+  /** Payload length of the last complete frame */
+  byte length;
+  /** Payload of the last complete frame */
+  byte payload[COMMAND_MAX_PAYLOAD];
+  /** Number of dropped frames */
+  unsigned int droppedFrames;
+
+  SerialCommandChannel()
+    : state(MARKER), droppedFrames(0)
+  {}
+
+  /**
+   * Feeds one received byte into the parser.
+   * @return true if a frame has been completed by this byte
+   */
+  boolean feed(const byte data) {
+    switch (state) {
+    case MARKER:
+      if (data == COMMAND_FRAME_MARKER) {
+        crc = 0;
+        state = COMMAND;
+      }
+      return false;
+    case COMMAND:
+      command = data;
+      state = LENGTH;
+      break;
+    case LENGTH:
+      if (data > COMMAND_MAX_PAYLOAD) {
+        droppedFrames++;
+        state = MARKER;
+        return false;
+      }
+      length = data;
+      payloadSize = 0;
+      state = length > 0 ? PAYLOAD : CRC;
+      break;
+    case PAYLOAD:
+      payload[payloadSize++] = data;
+      if (payloadSize == length) {
+        state = CRC;
+      }
+      break;
+    case CRC:
+      state = MARKER;
+      if (data != crc) {
+        droppedFrames++;
+        return false;
+      }
+      return true;
+    }
+    crc = crc8Update(crc, data);
+    return false;
+  }
+
+  /**
+   * Writes a frame to serial, as a single write.
+   */
+  static void send(const byte command, const byte* payload, const byte length) {
+    byte frame[COMMAND_MAX_PAYLOAD + 4];
+    frame[0] = COMMAND_FRAME_MARKER;
+    frame[1] = command;
+    frame[2] = length;
+    byte crc = crc8Update(crc8Update(0, command), length);
+    for (int i = 0; i < length; i++) {
+      frame[3 + i] = payload[i];
+      crc = crc8Update(crc, payload[i]);
+    }
+    frame[3 + length] = crc;
+    Serial.write(frame, length + 4);
+  }
+};
+
+#endif // SerialCommandChannel_h
@@ -0,0 +1,290 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2014 - 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef StenoEngine_h
+#define StenoEngine_h
+
+/**
+ * Turns key matrix readings into strokes: debouncing,
+ * chord recording and splitting of overlapping strokes.
+ *
+ * All state lives in the instance and time is passed in,
+ * and there is no hardware access,
+ * so several independent engines can run side by side,
+ * eg. to replay recorded key matrix traces with different settings.
+ */
+class StenoEngine {
+
+  boolean isStrokeInProgress;
+  boolean isChordReleasing;
+  unsigned long chordReleaseMicros;
+  boolean currentChord[ROWS][COLS];
+  boolean nextChord[ROWS][COLS];
+  boolean heldOverKeys[ROWS][COLS];
+  boolean currentKeyReadings[ROWS][COLS];
+  boolean previousKeyReadings[ROWS][COLS];
+  unsigned long keyPressMicros[ROWS][COLS];
+  boolean debouncingKeys[ROWS][COLS];
+  unsigned long debouncingMicros[ROWS][COLS];
+
+  /**
+   * Records all pressed keys into the current chord.
+   * Once a key of the current chord has been released, keys pressed
+   * at least rolloverMinGapMillis later are recorded into the next chord
+   * instead, and dropped from it again if released before the chords
+   * are split, as that is a bounce.
+   * @return false if no key is currently pressed
+   */
+  boolean recordCurrentKeys(const unsigned long nowMicros) {
+    boolean isAnyKeyPressed = false;
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        if (heldOverKeys[row][column]) {
+          continue;
+        }
+        const boolean isPressed = currentKeyReadings[row][column];
+        const boolean wasPressed = previousKeyReadings[row][column];
+        if (isPressed && !wasPressed) {
+          keyPressMicros[row][column] = nowMicros;
+          if (isChordReleasing && nowMicros - chordReleaseMicros >= rolloverMinGapMillis * 1000UL) {
+            nextChord[row][column] = true;
+          }
+        } else if (!isPressed && wasPressed) {
+          if (nextChord[row][column]) {
+            nextChord[row][column] = false;
+          } else if (rolloverSplitting && currentChord[row][column] && !isChordReleasing) {
+            isChordReleasing = true;
+            chordReleaseMicros = nowMicros;
+          }
+        }
+        if (isPressed) {
+          if (!nextChord[row][column]) {
+            currentChord[row][column] = true;
+          }
+          isAnyKeyPressed = true;
+        }
+      }
+    }
+    return isAnyKeyPressed;
+  }
+
+  /**
+   * Checks whether any key of the next chord has been held
+   * for at least rolloverMinPressMillis.
+   */
+  boolean isNextChordDebounced(const unsigned long nowMicros) const {
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        if (nextChord[row][column] && nowMicros - keyPressMicros[row][column] >= rolloverMinPressMillis * 1000UL) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Moves the current chord to the stroke and makes the next chord
+   * the current one.
+   * Keys of the stroke that are still held are ignored until released,
+   * so they do not end up in the next stroke as well.
+   */
+  void splitChords() {
+    copyBooleanMatrix(currentChord, stroke);
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        heldOverKeys[row][column] = currentKeyReadings[row][column] && !nextChord[row][column];
+        currentChord[row][column] = nextChord[row][column];
+        nextChord[row][column] = false;
+      }
+    }
+    isChordReleasing = false;
+  }
+
+  /**
+   * Stops ignoring keys held over from a split chord, once they are released.
+   */
+  void checkHeldOverKeys() {
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        if (heldOverKeys[row][column] && currentKeyReadings[row][column] == false) {
+          heldOverKeys[row][column] = false;
+        }
+      }
+    }
+  }
+
+  /**
+   * Checks for debouncing keys.
+   * If a key is pressed, we add it to the debouncing keys and record the time.
+   * @see https://en.wikipedia.org/wiki/Keyboard_technology#Debouncing
+   */
+  void checkNewDebouncingKeys(const unsigned long nowMicros) {
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        if (currentKeyReadings[row][column] == true && debouncingKeys[row][column] == false
+            && heldOverKeys[row][column] == false) {
+          debouncingKeys[row][column] = true;
+          debouncingMicros[row][column] = nowMicros;
+        }
+      }
+    }
+  }
+
+  /**
+   * Checks already debouncing keys.
+   * If a key debounces, start chord recording.
+   */
+  void checkAlreadyDebouncingKeys(const unsigned long nowMicros) {
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        if (debouncingKeys[row][column] == true && currentKeyReadings[row][column] == false) {
+          debouncingKeys[row][column] = false;
+          continue;
+        }
+        if (debouncingKeys[row][column] == true && nowMicros - debouncingMicros[row][column] >= debounceMillis * 1000UL) {
+          isStrokeInProgress = true;
+          currentChord[row][column] = true;
+          return;
+        }
+      }
+    }
+  }
+
+  /**
+   * Sets all values of all chord state boolean matrixes to false.
+   * Held over keys and the previous key readings are kept,
+   * as they refer to the physical key states.
+   */
+  void clearBooleanMatrixes() {
+    clearBooleanMatrix(currentChord, false);
+    clearBooleanMatrix(nextChord, false);
+    clearBooleanMatrix(debouncingKeys, false);
+    isChordReleasing = false;
+  }
+
+  /**
+   * Sets all values of the passed matrix to the given value.
+   */
+  static void clearBooleanMatrix(boolean booleanMatrix[][COLS], const boolean value) {
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        booleanMatrix[row][column] = value;
+      }
+    }
+  }
+
+  /**
+   * Copies all values of the source matrix into the target matrix.
+   */
+  static void copyBooleanMatrix(const boolean source[][COLS], boolean target[][COLS]) {
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        target[row][column] = source[row][column];
+      }
+    }
+  }
+
+public:
+
+  /** Time a key has to be held before it starts a stroke */
+  long debounceMillis;
+  /** Whether overlapping strokes are split, instead of merged into one chord */
+  boolean rolloverSplitting;
+  /** Minimum time after the first key release of a chord, for a new key press to start the next chord */
+  long rolloverMinGapMillis;
+  /** Minimum time a key of the next chord has to be held, to split the chords */
+  long rolloverMinPressMillis;
+
+  /** The last finished stroke, valid after update() returned true */
+  boolean stroke[ROWS][COLS];
+  /**
+   * The time the last finished stroke was finished,
+   * by the release of all its keys or by the next stroke being split off
+   */
+  unsigned long strokeMicros;
+
+  StenoEngine()
+    : debounceMillis(::debounceMillis),
+      rolloverSplitting(::rolloverSplitting),
+      rolloverMinGapMillis(::rolloverMinGapMillis),
+      rolloverMinPressMillis(::rolloverMinPressMillis)
+  {
+    reset();
+  }
+
+  /**
+   * Forgets all key and chord state.
+   */
+  void reset() {
+    isStrokeInProgress = false;
+    clearBooleanMatrixes();
+    clearBooleanMatrix(heldOverKeys, false);
+    clearBooleanMatrix(currentKeyReadings, false);
+    clearBooleanMatrix(previousKeyReadings, false);
+    clearBooleanMatrix(stroke, false);
+    strokeMicros = 0;
+  }
+
+  /**
+   * Handles one scan of the key matrix.
+   * @param keyReadings true for every key currently pressed
+   * @param nowMicros the time of the scan
+   * @return true if a stroke has been finished, which is then in stroke
+   */
+  boolean update(const boolean (&keyReadings)[ROWS][COLS], const unsigned long nowMicros) {
+    copyBooleanMatrix(keyReadings, currentKeyReadings);
+    checkHeldOverKeys();
+
+    boolean isAnyKeyPressed = true;
+    boolean isStrokeFinished = false;
+
+    // If stroke is not in progress, check debouncing keys
+    if (!isStrokeInProgress) {
+      checkAlreadyDebouncingKeys(nowMicros);
+      if (!isStrokeInProgress) checkNewDebouncingKeys(nowMicros);
+    }
+
+    // If any key was pressed, record all pressed keys
+    if (isStrokeInProgress) {
+      isAnyKeyPressed = recordCurrentKeys(nowMicros);
+    }
+
+    // If the next stroke has started before this one ended, split them
+    if (isAnyKeyPressed && isStrokeInProgress && isNextChordDebounced(nowMicros)) {
+      splitChords();
+      strokeMicros = nowMicros;
+      isStrokeFinished = true;
+    }
+
+    // If all keys have been released, finish the stroke and reset the chord state
+    if (!isAnyKeyPressed) {
+      copyBooleanMatrix(currentChord, stroke);
+      clearBooleanMatrixes();
+      isStrokeInProgress = false;
+      strokeMicros = nowMicros;
+      isStrokeFinished = true;
+    }
+
+    copyBooleanMatrix(currentKeyReadings, previousKeyReadings);
+    return isStrokeFinished;
+  }
+};
+
+#endif // StenoEngine_h
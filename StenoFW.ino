@@ -24,17 +24,29 @@
 #define PROTOCOL_SUPPORT_GEMINI
 #define PROTOCOL_SUPPORT_NKRO
 #define PROTOCOL_SUPPORT_TX_BOLT
+#define PROTOCOL_SUPPORT_STROKE_BATCH
 
 //#define PROTOCOL_DEFAULT protocolTest
 //#define PROTOCOL_DEFAULT protocolStenoKeyboard
 //#define PROTOCOL_DEFAULT protocolGemini
 #define PROTOCOL_DEFAULT protocolNKRO
 //#define PROTOCOL_DEFAULT protocolTxBolt
+//#define PROTOCOL_DEFAULT protocolStrokeBatch
+
+// Stroke frequency statistics, comment out STROKE_STATS to save SRAM.
+// Uses about DEPTH * WIDTH * 2 + TOP_K * 6 bytes.
+#define STROKE_STATS
+#define STROKE_STATS_SKETCH_DEPTH 2
+#define STROKE_STATS_SKETCH_WIDTH 64
+#define STROKE_STATS_TOP_K 8
 
 #include "StenoboardKeyboardDefinition.h"
 
 // Configuration section (end)
 
+#if defined(PROTOCOL_SUPPORT_STENO_KEYBOARD) || defined(PROTOCOL_SUPPORT_NKRO)
+  #include "HidReportScheduler.h"
+#endif
 #ifdef PROTOCOL_SUPPORT_TEST
   #include "TestProtocol.h"
 #endif
@@ -50,43 +62,76 @@
 #ifdef PROTOCOL_SUPPORT_TX_BOLT
   #include "TxBoltProtocol.h"
 #endif
+#ifdef PROTOCOL_SUPPORT_STROKE_BATCH
+  #include "StrokeBatchProtocol.h"
+#endif
+#include "StenoEngine.h"
+#include "Scheduler.h"
+#include "SerialCommandChannel.h"
+#ifdef STROKE_STATS
+  #include "ChordBitmask.h"
+  #include "StrokeFrequencySketch.h"
+#endif
 
 // Keyboard state variables
-boolean isStrokeInProgress = false;
-boolean currentChord[ROWS][COLS];
+StenoEngine engine;
+// The stroke to send, as handled by sendChord() and the fn key functions
+const boolean (&currentChord)[ROWS][COLS] = engine.stroke;
 boolean currentKeyReadings[ROWS][COLS];
-boolean debouncingKeys[ROWS][COLS];
-unsigned long debouncingMicros[ROWS][COLS];
+unsigned int rowSettleMicros[ROWS];
+unsigned int scanIntervalMicros = 0;
+unsigned long lastScanMicros;
 
 // Other state variables
 int ledIntensity = 1; // Min 0 - Max 255
+SerialCommandChannel commandChannel;
+boolean isTelemetryOn = false;
+#ifdef STROKE_STATS
+StrokeFrequencySketch<STROKE_STATS_SKETCH_DEPTH, STROKE_STATS_SKETCH_WIDTH, STROKE_STATS_TOP_K> strokeStats;
+#endif
 
 // Protocols
+#if defined(PROTOCOL_SUPPORT_STENO_KEYBOARD) || defined(PROTOCOL_SUPPORT_NKRO)
+HidReportScheduler hidReports;
+#endif
 #ifdef PROTOCOL_SUPPORT_TEST
 Protocol* protocolTest = new TestProtocol();
 #endif
 #ifdef PROTOCOL_SUPPORT_STENO_KEYBOARD
-Protocol* protocolStenoKeyboard = new StenoKeyboardProtocol();
+Protocol* protocolStenoKeyboard = new StenoKeyboardProtocol(hidReports);
 #endif
 #ifdef PROTOCOL_SUPPORT_GEMINI
 Protocol* protocolGemini = new GeminiProtocol();
 #endif
 #ifdef PROTOCOL_SUPPORT_NKRO
-Protocol* protocolNKRO = new NKROProtocol();
+Protocol* protocolNKRO = new NKROProtocol(hidReports);
 #endif
 #ifdef PROTOCOL_SUPPORT_TX_BOLT
 Protocol* protocolTxBolt = new TxBoltProtocol();
 #endif
+#ifdef PROTOCOL_SUPPORT_STROKE_BATCH
+Protocol* protocolStrokeBatch = new StrokeBatchProtocol();
+#endif
 Protocol* protocol = PROTOCOL_DEFAULT;
 
+// Tasks run by the scheduler in between key scans
+void updateProtocol();
+void readSerialCommand();
+const Task tasks[] = {
+  // function, period, deadline (micros), priority
+  {updateProtocol, 1000, 1000, 0},
+  {readSerialCommand, 200, 1000, 1},
+};
+const int TASK_COUNT = sizeof(tasks) / sizeof(tasks[0]);
+TaskState taskStates[TASK_COUNT];
+Scheduler scheduler(tasks, taskStates, TASK_COUNT, micros);
+
 /**
  * Sets up the initial state.
  * This is called when the keyboard is connected.
  */
 void setup() {
-#if defined(PROTOCOL_SUPPORT_GEMINI) || defined(PROTOCOL_SUPPORT_TX_BOLT)
   Serial.begin(9600);
-#endif
   for (int column = 0; column < COLS; column++) {
     pinMode(colPins[column], INPUT_PULLUP);
   }
@@ -96,107 +141,320 @@ void setup() {
   }
   pinMode(ledPin, OUTPUT);
   analogWrite(ledPin, ledIntensity);
-  clearBooleanMatrixes();
+  for (int id = 0; id < 0xFF; id++) {
+    if (protocolById(id) != 0) {
+      protocolById(id)->setStrokeSentListener(strokeSent);
+    }
+  }
+#if defined(PROTOCOL_SUPPORT_STENO_KEYBOARD) || defined(PROTOCOL_SUPPORT_NKRO)
+  hidReports.setStrokeSentListener(strokeSent);
+#endif
+  calibrateRowSettleTimes();
+  scheduler.begin();
 }
 
 /**
- * Reads key states and handles all chord events.
+ * Scans the keys, at most once every scanIntervalMicros,
+ * sends a queued keyboard emulation report if a USB frame has started,
+ * then runs the next due task.
  * This run in an endless loop.
  */
 void loop() {
+  if (micros() - lastScanMicros >= scanIntervalMicros) {
+    lastScanMicros = micros();
+    scanKeys();
+  }
+  updateHidReports();
+  scheduler.runNext();
+}
+
+/**
+ * Reads key states and handles all chord events.
+ */
+void scanKeys() {
   readKeys();
+  if (engine.update(currentKeyReadings, micros())) {
+    sendChord();
+  }
+}
 
-  boolean isAnyKeyPressed = true;
+/**
+ * Lets the current protocol send data independently of new chords.
+ */
+void updateProtocol() {
+  protocol->update();
+}
 
-  // If stroke is not in progress, check debouncing keys
-  if (!isStrokeInProgress) {
-    checkAlreadyDebouncingKeys();
-    if (!isStrokeInProgress) checkNewDebouncingKeys();
+/**
+ * Sends the next queued keyboard emulation report, once per USB frame.
+ * This only checks the frame number when there is nothing to send,
+ * so it is run on every loop iteration rather than as a task,
+ * to stay in step with the frames.
+ */
+void updateHidReports() {
+#if defined(PROTOCOL_SUPPORT_STENO_KEYBOARD) || defined(PROTOCOL_SUPPORT_NKRO)
+  hidReports.update();
+#endif
+}
+
+/**
+ * Feeds at most one received byte to the serial command channel,
+ * and handles the command once a frame is complete.
+ */
+void readSerialCommand() {
+  if (Serial.available() > 0 && commandChannel.feed(Serial.read())) {
+    handleSerialCommand();
   }
+}
 
-  // If any key was pressed, record all pressed keys
-  if (isStrokeInProgress) {
-    isAnyKeyPressed = recordCurrentKeys();
+/**
+ * Handles the last command received on the serial command channel.
+ * Set commands reply with the resulting value, just like get commands.
+ */
+void handleSerialCommand() {
+  const byte command = commandChannel.command;
+  const byte* payload = commandChannel.payload;
+  const byte length = commandChannel.length;
+  const int expectedLength = commandPayloadLength(command);
+  if (expectedLength < 0) {
+    sendCommandError(command, COMMAND_ERROR_UNKNOWN_COMMAND);
+    return;
+  }
+  if (length != expectedLength) {
+    sendCommandError(command, COMMAND_ERROR_BAD_PAYLOAD);
+    return;
   }
 
-  // If all keys have been released, send the chord and reset global state
-  if (!isAnyKeyPressed) {
-    sendChord();
-    clearBooleanMatrixes();
-    isStrokeInProgress = false;
+  byte reply[10];
+  byte replyLength = 1;
+  switch (command) {
+  case COMMAND_SET_PROTOCOL:
+    if (protocolById(payload[0]) == 0) {
+      sendCommandError(command, COMMAND_ERROR_BAD_VALUE);
+      return;
+    }
+    setProtocol(protocolById(payload[0]));
+    // Fall through
+  case COMMAND_GET_PROTOCOL:
+    reply[0] = protocolId(protocol);
+    break;
+  case COMMAND_SET_DEBOUNCE:
+    engine.debounceMillis = payload[0];
+    // Fall through
+  case COMMAND_GET_DEBOUNCE:
+    reply[0] = engine.debounceMillis;
+    break;
+  case COMMAND_SET_SCAN_INTERVAL:
+    scanIntervalMicros = payload[0] | ((unsigned int) payload[1] << 8);
+    // Fall through
+  case COMMAND_GET_SCAN_INTERVAL:
+    reply[0] = scanIntervalMicros & 0xFF;
+    reply[1] = scanIntervalMicros >> 8;
+    replyLength = 2;
+    break;
+  case COMMAND_SET_EMISSION_MODE:
+    if (payload[0] != EMISSION_MODE_ON_RELEASE && payload[0] != EMISSION_MODE_ROLLOVER) {
+      sendCommandError(command, COMMAND_ERROR_BAD_VALUE);
+      return;
+    }
+    engine.rolloverSplitting = payload[0] == EMISSION_MODE_ROLLOVER;
+    // Fall through
+  case COMMAND_GET_EMISSION_MODE:
+    reply[0] = engine.rolloverSplitting ? EMISSION_MODE_ROLLOVER : EMISSION_MODE_ON_RELEASE;
+    break;
+  case COMMAND_SET_TELEMETRY:
+    isTelemetryOn = payload[0] != 0;
+    reply[0] = isTelemetryOn;
+    break;
+#if defined(PROTOCOL_SUPPORT_STENO_KEYBOARD) || defined(PROTOCOL_SUPPORT_NKRO)
+  case COMMAND_GET_HID_STATS: {
+    const unsigned int averageDelayMicros = min(hidReports.averageDelayMicros(), 0xFFFFUL);
+    reply[0] = averageDelayMicros & 0xFF;
+    reply[1] = averageDelayMicros >> 8;
+    reply[2] = hidReports.maxDelayMicros & 0xFF;
+    reply[3] = hidReports.maxDelayMicros >> 8;
+    reply[4] = hidReports.sentReports;
+    reply[5] = hidReports.sentReports >> 8;
+    reply[6] = hidReports.sentReports >> 16;
+    reply[7] = hidReports.sentReports >> 24;
+    reply[8] = hidReports.overflows & 0xFF;
+    reply[9] = hidReports.overflows >> 8;
+    replyLength = 10;
+    break;
   }
+#endif
+  case COMMAND_GET_TASK_STATS:
+    sendTaskStats();
+    return;
+#ifdef STROKE_STATS
+  case COMMAND_GET_STROKE_STATS:
+    sendStrokeStats();
+    return;
+  case COMMAND_RESET_STROKE_STATS:
+    strokeStats.reset();
+    replyLength = 0;
+    break;
+#endif
+  default:
+    sendCommandError(command, COMMAND_ERROR_UNKNOWN_COMMAND);
+    return;
+  }
+  SerialCommandChannel::send(command | COMMAND_REPLY, reply, replyLength);
 }
 
 /**
- * Records all pressed keys into the current chord.
- * @return false if no key is currently pressed
+ * Returns the payload length the given command expects,
+ * or -1 if the command is unknown or not supported by this build.
  */
-boolean recordCurrentKeys() {
-  boolean isAnyKeyPressed = false;
-  for (int row = 0; row < ROWS; row++) {
-    for (int column = 0; column < COLS; column++) {
-      if (currentKeyReadings[row][column] == true) {
-        currentChord[row][column] = true;
-        isAnyKeyPressed = true;
-      }
-    }
+int commandPayloadLength(const byte command) {
+  switch (command) {
+  case COMMAND_SET_SCAN_INTERVAL:
+    return 2;
+  case COMMAND_SET_PROTOCOL:
+  case COMMAND_SET_DEBOUNCE:
+  case COMMAND_SET_EMISSION_MODE:
+  case COMMAND_SET_TELEMETRY:
+    return 1;
+  case COMMAND_GET_PROTOCOL:
+  case COMMAND_GET_DEBOUNCE:
+  case COMMAND_GET_SCAN_INTERVAL:
+  case COMMAND_GET_EMISSION_MODE:
+  case COMMAND_GET_TASK_STATS:
+#if defined(PROTOCOL_SUPPORT_STENO_KEYBOARD) || defined(PROTOCOL_SUPPORT_NKRO)
+  case COMMAND_GET_HID_STATS:
+#endif
+#ifdef STROKE_STATS
+  case COMMAND_GET_STROKE_STATS:
+  case COMMAND_RESET_STROKE_STATS:
+#endif
+    return 0;
+  default:
+    return -1;
   }
-  return isAnyKeyPressed;
 }
 
 /**
- * Checks for debouncing keys.
- * If a key is pressed, we add it to the debouncing keys and record the time.
- * @see https://en.wikipedia.org/wiki/Keyboard_technology#Debouncing
+ * Sends an error frame for the given command.
  */
-void checkNewDebouncingKeys() {
-  for (int row = 0; row < ROWS; row++) {
-    for (int column = 0; column < COLS; column++) {
-      if (currentKeyReadings[row][column] == true && debouncingKeys[row][column] == false) {
-        debouncingKeys[row][column] = true;
-        debouncingMicros[row][column] = micros();
-      }
-    }
+void sendCommandError(const byte command, const byte errorCode) {
+  const byte payload[] = {command, errorCode};
+  SerialCommandChannel::send(COMMAND_ERROR, payload, 2);
+}
+
+/**
+ * Is called by the protocols once a stroke has actually been sent.
+ */
+void strokeSent(const unsigned long strokeMicros) {
+  if (isTelemetryOn) {
+    sendStrokeTelemetry(micros() - strokeMicros);
   }
 }
+
 /**
- * Checks already debouncing keys.
- * If a key debounces, start chord recording.
+ * Sends the telemetry frame of a stroke.
  */
-void checkAlreadyDebouncingKeys() {
-  for (int row = 0; row < ROWS; row++) {
-    for (int column = 0; column < COLS; column++) {
-      if (debouncingKeys[row][column] == true && currentKeyReadings[row][column] == false) {
-        debouncingKeys[row][column] = false;
-        continue;
-      }
-      if (debouncingKeys[row][column] == true && micros() - debouncingMicros[row][column] / 1000 > debounceMillis) {
-        isStrokeInProgress = true;
-        currentChord[row][column] = true;
-        return;
-      }
-    }
+void sendStrokeTelemetry(const unsigned long latencyMicros) {
+  const byte payload[] = {
+    (byte) latencyMicros, (byte) (latencyMicros >> 8),
+    (byte) (latencyMicros >> 16), (byte) (latencyMicros >> 24)
+  };
+  SerialCommandChannel::send(COMMAND_TELEMETRY, payload, 4);
+}
+
+/**
+ * Sends the task statistics as a COMMAND_GET_TASK_STATS reply,
+ * followed by one frame per task.
+ */
+void sendTaskStats() {
+  const byte reply[] = {(byte) scheduler.getTaskCount()};
+  SerialCommandChannel::send(COMMAND_GET_TASK_STATS | COMMAND_REPLY, reply, 1);
+  for (int i = 0; i < scheduler.getTaskCount(); i++) {
+    const TaskState& state = scheduler.getTaskState(i);
+    const unsigned int maxRunMicros = min(state.maxRunMicros, 0xFFFFUL);
+    const byte entry[] = {
+      (byte) i,
+      (byte) state.runs, (byte) (state.runs >> 8), (byte) (state.runs >> 16), (byte) (state.runs >> 24),
+      (byte) state.overruns, (byte) (state.overruns >> 8),
+      (byte) maxRunMicros, (byte) (maxRunMicros >> 8)
+    };
+    SerialCommandChannel::send(COMMAND_TASK_STATS_ENTRY, entry, 9);
   }
 }
 
+#ifdef STROKE_STATS
 /**
- * Sets all values of all boolean matrixes to false.
+ * Sends the stroke frequency statistics as a COMMAND_GET_STROKE_STATS reply,
+ * followed by one frame per heavy hitter.
  */
-void clearBooleanMatrixes() {
-  clearBooleanMatrix(currentChord, false);
-  clearBooleanMatrix(currentKeyReadings, false);
-  clearBooleanMatrix(debouncingKeys, false);
+void sendStrokeStats() {
+  const unsigned long total = strokeStats.total();
+  const byte reply[] = {
+    (byte) total, (byte) (total >> 8), (byte) (total >> 16), (byte) (total >> 24),
+    (byte) strokeStats.topStrokeCount()
+  };
+  SerialCommandChannel::send(COMMAND_GET_STROKE_STATS | COMMAND_REPLY, reply, 5);
+  for (int i = 0; i < strokeStats.topStrokeCount(); i++) {
+    const unsigned long chord = strokeStats.topStroke(i);
+    const unsigned int estimate = strokeStats.topStrokeEstimate(i);
+    const byte entry[] = {
+      (byte) i,
+      (byte) chord, (byte) (chord >> 8), (byte) (chord >> 16), (byte) (chord >> 24),
+      (byte) estimate, (byte) (estimate >> 8)
+    };
+    SerialCommandChannel::send(COMMAND_STROKE_STATS_ENTRY, entry, 7);
+  }
 }
+#endif
 
 /**
- * Sets all values of the passed matrix to the given value.
+ * Switches to the given protocol,
+ * after letting the current one send what it still holds back.
  */
-void clearBooleanMatrix(boolean booleanMatrix[][COLS], const boolean value) {
-  for (int row = 0; row < ROWS; row++) {
-    for (int column = 0; column < COLS; column++) {
-      booleanMatrix[row][column] = value;
+void setProtocol(Protocol* const newProtocol) {
+  if (newProtocol != protocol) {
+    protocol->flush();
+    protocol = newProtocol;
+  }
+}
+
+/**
+ * Returns the protocol with the given serial command channel id,
+ * or 0 if it is unknown or not supported.
+ */
+Protocol* protocolById(const byte id) {
+  switch (id) {
+#ifdef PROTOCOL_SUPPORT_TEST
+  case 0: return protocolTest;
+#endif
+#ifdef PROTOCOL_SUPPORT_STENO_KEYBOARD
+  case 1: return protocolStenoKeyboard;
+#endif
+#ifdef PROTOCOL_SUPPORT_GEMINI
+  case 2: return protocolGemini;
+#endif
+#ifdef PROTOCOL_SUPPORT_NKRO
+  case 3: return protocolNKRO;
+#endif
+#ifdef PROTOCOL_SUPPORT_TX_BOLT
+  case 4: return protocolTxBolt;
+#endif
+#ifdef PROTOCOL_SUPPORT_STROKE_BATCH
+  case 5: return protocolStrokeBatch;
+#endif
+  default: return 0;
+  }
+}
+
+/**
+ * Returns the serial command channel id of the given protocol.
+ */
+byte protocolId(const Protocol* const protocol) {
+  for (byte id = 0; id < 0xFF; id++) {
+    if (protocolById(id) == protocol) {
+      return id;
     }
   }
+  return 0xFF;
 }
 
 /**
@@ -205,6 +463,9 @@ void clearBooleanMatrix(boolean booleanMatrix[][COLS], const boolean value) {
 void readKeys() {
   for (int row = 0; row < ROWS; row++) {
     digitalWrite(rowPins[row], LOW);
+    if (rowSettleMicros[row] > 0) {
+      delayMicroseconds(rowSettleMicros[row]);
+    }
     for (int column = 0; column < COLS; column++) {
       currentKeyReadings[row][column] = digitalRead(colPins[column]) == LOW ? true : false;
     }
@@ -212,6 +473,83 @@ void readKeys() {
   }
 }
 
+/**
+ * Measures how long each row takes to settle and stores the minimum safe
+ * delay for each row into rowSettleMicros, which readKeys() then waits for.
+ * The slow edge while scanning is a column rising back through its pull-up
+ * after a pressed key of the previous row pulled it low.
+ * So for every row, all columns are discharged by driving them low,
+ * then released to their pull-ups while the row is driven low,
+ * and the number of column read passes that still see a low column
+ * is counted. Times the duration of one read pass, that is the delay
+ * needed on top of what readKeys() itself takes, so it can be 0.
+ * The rows not being measured are switched to high impedance meanwhile,
+ * so a held key never connects a low column to a high row.
+ * A row that does not settle within rowSettleMaxMicros,
+ * eg. because a key of it is held, keeps that value as its delay.
+ */
+void calibrateRowSettleTimes() {
+  for (int row = 0; row < ROWS; row++) {
+    pinMode(rowPins[row], INPUT);
+    rowSettleMicros[row] = rowSettleMaxMicros;
+  }
+
+  // Time a read pass with nothing to settle, averaged to beat the resolution of micros()
+  const int timingPasses = 32;
+  const unsigned long timingStartMicros = micros();
+  for (int pass = 0; pass < timingPasses; pass++) {
+    areAllColumnsHigh();
+  }
+  const unsigned long passMicros = (micros() - timingStartMicros + timingPasses - 1) / timingPasses;
+  const unsigned long maxPasses = rowSettleMaxMicros / max(passMicros, 1UL);
+
+  for (int row = 0; row < ROWS; row++) {
+    unsigned long slowestPasses = 0;
+    digitalWrite(rowPins[row], LOW);
+    pinMode(rowPins[row], OUTPUT);
+    for (int sample = 0; sample < rowSettleCalibrationSamples; sample++) {
+      for (int column = 0; column < COLS; column++) {
+        pinMode(colPins[column], OUTPUT);
+        digitalWrite(colPins[column], LOW);
+      }
+      for (int column = 0; column < COLS; column++) {
+        pinMode(colPins[column], INPUT_PULLUP);
+      }
+      unsigned long lowPasses = 0;
+      while (!areAllColumnsHigh() && lowPasses <= maxPasses) {
+        lowPasses++;
+      }
+      if (lowPasses > slowestPasses) {
+        slowestPasses = lowPasses;
+      }
+    }
+    pinMode(rowPins[row], INPUT);
+    if (slowestPasses == 0) {
+      rowSettleMicros[row] = 0;
+    } else if (slowestPasses <= maxPasses
+        && slowestPasses * passMicros + rowSettleMarginMicros < rowSettleMaxMicros) {
+      rowSettleMicros[row] = slowestPasses * passMicros + rowSettleMarginMicros;
+    }
+  }
+
+  for (int row = 0; row < ROWS; row++) {
+    pinMode(rowPins[row], OUTPUT);
+    digitalWrite(rowPins[row], HIGH);
+  }
+}
+
+/**
+ * Checks whether every column currently reads high.
+ */
+boolean areAllColumnsHigh() {
+  for (int column = 0; column < COLS; column++) {
+    if (digitalRead(colPins[column]) == LOW) {
+      return false;
+    }
+  }
+  return true;
+}
+
 /**
  * Sends the chord using the current protocol.
  * If there are fn keys pressed, delegate to the corresponding function instead.
@@ -228,7 +566,10 @@ void sendChord() {
   } else if (currentChord[KEY_FN2_D0][KEY_FN2_D1]) {
     pressedFn2();
   } else {
-    protocol->sendChord(currentChord);
+    protocol->sendChord(currentChord, engine.strokeMicros);
+#ifdef STROKE_STATS
+    strokeStats.update(chordToBitmask(currentChord));
+#endif
   }
 }
 
@@ -242,39 +583,46 @@ void sendChord() {
  *   PH-G   ->   Set Gemini PR protocol mode
  *   PH-PB  ->   Set NKRO Keyboard emulation mode
  *   PH-B   ->   Set TX Bolt protocol mode
+ *   PH-D   ->   Set stroke batch (delta encoded) protocol mode
  */
 void pressedFn1() {
-#if defined(PROTOCOL_SUPPORT_GEMINI) || defined(PROTOCOL_SUPPORT_NKRO) || defined(PROTOCOL_SUPPORT_TX_BOLT)
+#if defined(PROTOCOL_SUPPORT_GEMINI) || defined(PROTOCOL_SUPPORT_NKRO) || defined(PROTOCOL_SUPPORT_TX_BOLT) || defined(PROTOCOL_SUPPORT_STROKE_BATCH)
   // "PH" -> Set protocol
   if (currentChord[KEY_P_D0][KEY_P_D1] && currentChord[KEY_H_D0][KEY_H_D1]) {
   #ifdef PROTOCOL_SUPPORT_TEST
     // "-T" -> Test
     if (currentChord[KEY_t_D0][KEY_t_D1]) {
-      protocol = protocolTest;
+      setProtocol(protocolTest);
     }
   #endif
   #ifdef PROTOCOL_SUPPORT_STENO_KEYBOARD
     // "-S" -> Test
     if (currentChord[KEY_s_D0][KEY_s_D1]) {
-      protocol = protocolStenoKeyboard;
+      setProtocol(protocolStenoKeyboard);
     }
   #endif
   #ifdef PROTOCOL_SUPPORT_GEMINI
     // "-G" -> Gemini
     if (currentChord[KEY_g_D0][KEY_g_D1]) {
-      protocol = protocolGemini;
+      setProtocol(protocolGemini);
     }
   #endif
   #ifdef PROTOCOL_SUPPORT_TX_BOLT
     // "-B" -> TX Bolt
     if (currentChord[KEY_b_D0][KEY_b_D1]) {
-      protocol = protocolTxBolt;
+      setProtocol(protocolTxBolt);
+    }
+  #endif
+  #ifdef PROTOCOL_SUPPORT_STROKE_BATCH
+    // "-D" -> Stroke batch
+    if (currentChord[KEY_d_D0][KEY_d_D1]) {
+      setProtocol(protocolStrokeBatch);
     }
   #endif
   #ifdef PROTOCOL_SUPPORT_NKRO
     // "-PB" -> NKRO Keyboard
     if (currentChord[KEY_p_D0][KEY_p_D1] && currentChord[KEY_b_D0][KEY_b_D1]) {
-      protocol = protocolNKRO;
+      setProtocol(protocolNKRO);
     }
   #endif
   }
@@ -287,10 +635,31 @@ void pressedFn1() {
  * Tip: maybe it is better to avoid using "fn2" key alone in order to avoid
  * accidental activation?
  *
- * Current functions: none
+ * Current functions:
+ *   -T   ->   Recalibrate the row settle times
+ *   -S   ->   Send the stroke frequency statistics over serial, see COMMAND_GET_STROKE_STATS
+ *   -Z   ->   Reset the stroke frequency statistics
+ *   -D   ->   Send the task statistics over serial, see COMMAND_GET_TASK_STATS
  */
 void pressedFn2() {
-
+  // "-T" -> Recalibrate the row settle times
+  if (currentChord[KEY_t_D0][KEY_t_D1]) {
+    calibrateRowSettleTimes();
+  }
+#ifdef STROKE_STATS
+  // "-S" -> Send the stroke frequency statistics
+  if (currentChord[KEY_s_D0][KEY_s_D1]) {
+    sendStrokeStats();
+  }
+  // "-Z" -> Reset the stroke frequency statistics
+  if (currentChord[KEY_z_D0][KEY_z_D1]) {
+    strokeStats.reset();
+  }
+#endif
+  // "-D" -> Send the task statistics
+  if (currentChord[KEY_d_D0][KEY_d_D1]) {
+    sendTaskStats();
+  }
 }
 
 /**
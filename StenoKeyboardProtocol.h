@@ -21,6 +21,7 @@
 #define StenoKeyboardProtocol_h
 
 #include "Protocol.h"
+#include "HidReportScheduler.h"
 
 /**
  * Sends the current chord as human readable Steno mnemonic in steno order
@@ -28,11 +29,14 @@
  */
 class StenoKeyboardProtocol : public Protocol {
 
+  /** Spreads the key press and release reports over USB frames */
+  HidReportScheduler& hidReports;
+
   void pressKey(boolean* firstKeyPressed, const char key) const {
 
-    Keyboard.press(key);
+    hidReports.press(key);
     if (*firstKeyPressed) {
-      Keyboard.release(key);
+      hidReports.release(key);
     } else {
       (*firstKeyPressed) = true;
     }
@@ -40,11 +44,13 @@ class StenoKeyboardProtocol : public Protocol {
 
 public:
 
-  StenoKeyboardProtocol() {
+  StenoKeyboardProtocol(HidReportScheduler& hidReports)
+    : hidReports(hidReports)
+  {
     Keyboard.begin();
   }
 
-  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS]) const {
+  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS], const unsigned long strokeMicros) const {
 
     boolean firstKeyPressed = false;
 
@@ -99,8 +105,8 @@ public:
     }
 
     if (!centerKeyPressed) {
-      Keyboard.releaseAll();
-      Keyboard.press('-');
+      hidReports.releaseAll();
+      hidReports.press('-');
       firstKeyPressed = true;
     }
 
@@ -135,7 +141,8 @@ public:
       pressKey(&firstKeyPressed, 'Z');
     }
 
-    Keyboard.releaseAll();
+    hidReports.releaseAll();
+    hidReports.endStroke(strokeMicros);
   }
 };
 
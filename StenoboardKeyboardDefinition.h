@@ -107,6 +107,18 @@ const int rowPins[ROWS] = {13, 12, 11, 10, 9};
 const int colPins[COLS] = {8, 7, 6, 5, 4, 2};
 const int ledPin = 3;
 const long debounceMillis = 20;
+/** Whether overlapping strokes are split, instead of merged into one chord */
+const boolean rolloverSplitting = true;
+/** Minimum time after the first key release of a chord, for a new key press to start the next chord */
+const long rolloverMinGapMillis = 5;
+/** Minimum time a key of the next chord has to be held, to split the chords */
+const long rolloverMinPressMillis = 20;
+/** Upper bound for the settle delay of a row, used until a row is calibrated */
+const unsigned int rowSettleMaxMicros = 100;
+/** Safety margin added on top of the measured settle time of each row */
+const unsigned int rowSettleMarginMicros = 4;
+/** Number of measurements per row, the slowest of which is used */
+const int rowSettleCalibrationSamples = 8;
 
 #endif // StenoboardKeyboardDefinition_h
 
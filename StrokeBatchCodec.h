@@ -0,0 +1,268 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef StrokeBatchCodec_h
+#define StrokeBatchCodec_h
+
+#include <stdint.h>
+#include "Crc8.h"
+
+/*
+ * Packet format of the stroke batch protocol.
+ * It does not depend on the Arduino libraries,
+ * so hosts can include this file to decode the stream.
+ *
+ * byte 0        sync byte (STROKE_BATCH_SYNC)
+ * byte 1        sequence number, incremented with every packet
+ * byte 2        number of strokes in the packet
+ * byte 3        payload length in bytes
+ * payload       one varint per stroke, 7 bits per byte, least significant
+ *               group first, high bit set on all but the last byte.
+ *               Each value is the stroke bitmask XORed with the previous
+ *               stroke of the same packet (the first one with 0),
+ *               so a lost packet does not corrupt any following one.
+ * last byte     CRC-8 (polynomial 0x07) over bytes 1 up to the payload end
+ *
+ * Stroke bitmasks have the key at [row][column] in bit (row * COLS + column).
+ */
+
+#define STROKE_BATCH_SYNC 0xD5
+#define STROKE_BATCH_MAX_STROKES 8
+#define STROKE_BATCH_HEADER_SIZE 4
+#define STROKE_BATCH_MAX_VARINT_SIZE 5
+#define STROKE_BATCH_MAX_PACKET_SIZE \
+    (STROKE_BATCH_HEADER_SIZE + STROKE_BATCH_MAX_STROKES * STROKE_BATCH_MAX_VARINT_SIZE + 1)
+
+/**
+ * Encodes strokes into a single packet.
+ * @param packet has to hold at least STROKE_BATCH_MAX_PACKET_SIZE bytes
+ * @return the packet size in bytes
+ */
+inline int strokeBatchEncode(uint8_t* packet, const uint8_t sequence,
+    const uint32_t* strokes, const int strokeCount) {
+
+  int size = STROKE_BATCH_HEADER_SIZE;
+  uint32_t previous = 0;
+  for (int i = 0; i < strokeCount; i++) {
+    uint32_t delta = strokes[i] ^ previous;
+    previous = strokes[i];
+    while (delta >= 0x80) {
+      packet[size++] = (uint8_t) (delta | 0x80);
+      delta >>= 7;
+    }
+    packet[size++] = (uint8_t) delta;
+  }
+
+  packet[0] = STROKE_BATCH_SYNC;
+  packet[1] = sequence;
+  packet[2] = (uint8_t) strokeCount;
+  packet[3] = (uint8_t) (size - STROKE_BATCH_HEADER_SIZE);
+
+  uint8_t crc = 0;
+  for (int i = 1; i < size; i++) {
+    crc = crc8Update(crc, packet[i]);
+  }
+  packet[size++] = crc;
+  return size;
+}
+
+/**
+ * Incrementally decodes a stroke batch stream, one byte at a time.
+ * Packets with a bad count, length, CRC or payload are dropped,
+ * and all their bytes after the sync byte are scanned again,
+ * as the sync byte may have been a payload byte of a damaged packet
+ * with the real next packet starting in the bytes that followed.
+ * Such a rescan can complete several packets at once, so received bytes
+ * are handled like this:
+ *
+ *   for (int count = decoder.feed(data); count > 0; count = decoder.poll()) {
+ *     // use decoder.strokes[0] up to decoder.strokes[count - 1]
+ *   }
+ */
+class StrokeBatchDecoder {
+
+  enum State { SYNC, SEQUENCE, COUNT, LENGTH, PAYLOAD, CRC };
+
+  State state;
+  uint8_t crc;
+  /** Bytes of the packet being decoded, starting with the sync byte */
+  uint8_t frame[STROKE_BATCH_MAX_PACKET_SIZE];
+  int frameSize;
+  /** Bytes still to be scanned, the oldest first */
+  uint8_t backlog[2 * STROKE_BATCH_MAX_PACKET_SIZE + 1];
+  int backlogSize;
+  uint8_t expectedSequence;
+  bool hasSequence;
+
+  int decodePayload() {
+    const uint8_t count = frame[2];
+    const uint8_t* payload = frame + STROKE_BATCH_HEADER_SIZE;
+    const int payloadSize = frame[3];
+    uint32_t previous = 0;
+    int index = 0;
+    for (int i = 0; i < count; i++) {
+      uint32_t delta = 0;
+      int shift = 0;
+      for (;;) {
+        if (index >= payloadSize || shift > 28) {
+          return -1;
+        }
+        const uint8_t data = payload[index++];
+        delta |= (uint32_t) (data & 0x7F) << shift;
+        shift += 7;
+        if (!(data & 0x80)) {
+          break;
+        }
+      }
+      previous ^= delta;
+      strokes[i] = previous;
+    }
+    return index == payloadSize ? count : -1;
+  }
+
+  /**
+   * Drops the packet being decoded, and queues its bytes after the sync
+   * byte to be scanned again, ahead of the bytes not scanned yet.
+   */
+  void dropFrame() {
+    corruptPackets++;
+    const int rescanSize = frameSize - 1;
+    for (int i = backlogSize - 1; i >= 0; i--) {
+      backlog[i + rescanSize] = backlog[i];
+    }
+    for (int i = 0; i < rescanSize; i++) {
+      backlog[i] = frame[1 + i];
+    }
+    backlogSize += rescanSize;
+    frameSize = 0;
+    state = SYNC;
+  }
+
+  /**
+   * Handles one byte of the stream.
+   * @return the number of strokes now available in strokes[],
+   *   or 0 if no packet has been completed by this byte
+   */
+  int scan(const uint8_t data) {
+    if (state == SYNC) {
+      if (data == STROKE_BATCH_SYNC) {
+        frame[0] = data;
+        frameSize = 1;
+        crc = 0;
+        state = SEQUENCE;
+      }
+      return 0;
+    }
+
+    frame[frameSize++] = data;
+    switch (state) {
+    case SYNC:
+      break;
+    case SEQUENCE:
+      state = COUNT;
+      break;
+    case COUNT:
+      if (data == 0 || data > STROKE_BATCH_MAX_STROKES) {
+        dropFrame();
+        return 0;
+      }
+      state = LENGTH;
+      break;
+    case LENGTH:
+      if (data < frame[2] || data > STROKE_BATCH_MAX_STROKES * STROKE_BATCH_MAX_VARINT_SIZE) {
+        dropFrame();
+        return 0;
+      }
+      state = PAYLOAD;
+      break;
+    case PAYLOAD:
+      if (frameSize == STROKE_BATCH_HEADER_SIZE + frame[3]) {
+        state = CRC;
+      }
+      break;
+    case CRC: {
+      const int strokeCount = crc == data ? decodePayload() : -1;
+      if (strokeCount < 0) {
+        dropFrame();
+        return 0;
+      }
+      const uint8_t sequence = frame[1];
+      if (hasSequence) {
+        lostPackets += (uint8_t) (sequence - expectedSequence);
+      }
+      expectedSequence = sequence + 1;
+      hasSequence = true;
+      frameSize = 0;
+      state = SYNC;
+      return strokeCount;
+    }
+    }
+    crc = crc8Update(crc, data);
+    return 0;
+  }
+
+public:
+
+  /** Strokes of the last complete packet */
+  uint32_t strokes[STROKE_BATCH_MAX_STROKES];
+  /** Number of dropped packets, including false starts on payload bytes */
+  unsigned long corruptPackets;
+  /** Number of packets missing according to the sequence numbers */
+  unsigned long lostPackets;
+
+  StrokeBatchDecoder()
+    : state(SYNC), frameSize(0), backlogSize(0), hasSequence(false),
+      corruptPackets(0), lostPackets(0)
+  {}
+
+  /**
+   * Feeds one received byte into the decoder.
+   * Bytes queued for scanning again are handled first,
+   * up to the first complete packet.
+   * A dropped packet can leave further complete packets queued,
+   * so callers have to call poll() until it returns 0 after every feed().
+   * @return the number of strokes now available in strokes[],
+   *   or 0 if no packet has been completed
+   */
+  int feed(const uint8_t data) {
+    backlog[backlogSize++] = data;
+    return poll();
+  }
+
+  /**
+   * Scans the bytes queued for scanning again, without new input,
+   * up to the next complete packet.
+   * @return the number of strokes now available in strokes[],
+   *   or 0 if there is no further complete packet yet
+   */
+  int poll() {
+    int strokeCount = 0;
+    while (backlogSize > 0 && strokeCount == 0) {
+      const uint8_t next = backlog[0];
+      backlogSize--;
+      for (int i = 0; i < backlogSize; i++) {
+        backlog[i] = backlog[i + 1];
+      }
+      strokeCount = scan(next);
+    }
+    return strokeCount;
+  }
+};
+
+#endif // StrokeBatchCodec_h
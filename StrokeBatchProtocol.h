@@ -0,0 +1,86 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef StrokeBatchProtocol_h
+#define StrokeBatchProtocol_h
+
+#include "Protocol.h"
+#include "ChordBitmask.h"
+#include "StrokeBatchCodec.h"
+
+/**
+ * Sends chords over serial in batches, several strokes per packet.
+ * Each stroke is delta encoded against the previous one,
+ * see StrokeBatchCodec.h for the packet format.
+ * A packet is sent as soon as it is full,
+ * or once its first stroke has waited for flushMillis.
+ */
+class StrokeBatchProtocol : public Protocol {
+
+  const unsigned long flushMillis;
+
+  mutable uint32_t pendingStrokes[STROKE_BATCH_MAX_STROKES];
+  mutable unsigned long pendingStrokeMicros[STROKE_BATCH_MAX_STROKES];
+  mutable int pendingCount;
+  mutable unsigned long firstPendingMillis;
+  mutable uint8_t sequence;
+
+  void sendPending() const {
+    uint8_t packet[STROKE_BATCH_MAX_PACKET_SIZE];
+    const int size = strokeBatchEncode(packet, sequence, pendingStrokes, pendingCount);
+    Serial.write(packet, size);
+    sequence++;
+    for (int i = 0; i < pendingCount; i++) {
+      strokeSent(pendingStrokeMicros[i]);
+    }
+    pendingCount = 0;
+  }
+
+public:
+
+  StrokeBatchProtocol(const unsigned long flushMillis = 10)
+    : flushMillis(flushMillis), pendingCount(0), sequence(0)
+  {}
+
+  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS], const unsigned long strokeMicros) const {
+    if (pendingCount == 0) {
+      firstPendingMillis = millis();
+    }
+    pendingStrokes[pendingCount] = chordToBitmask(currentChord);
+    pendingStrokeMicros[pendingCount] = strokeMicros;
+    pendingCount++;
+    if (pendingCount == STROKE_BATCH_MAX_STROKES) {
+      sendPending();
+    }
+  }
+
+  virtual void update() {
+    if (pendingCount > 0 && millis() - firstPendingMillis >= flushMillis) {
+      sendPending();
+    }
+  }
+
+  virtual void flush() {
+    if (pendingCount > 0) {
+      sendPending();
+    }
+  }
+};
+
+#endif // StrokeBatchProtocol_h
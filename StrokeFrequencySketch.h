@@ -0,0 +1,149 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+#ifndef StrokeFrequencySketch_h
+#define StrokeFrequencySketch_h
+
+/**
+ * Counts how often strokes are written, in a fixed amount of memory.
+ *
+ * A count-min sketch of DEPTH rows with WIDTH counters each
+ * estimates the count of any stroke (never below the real count),
+ * and a table of the TOP_K strokes with the highest estimates
+ * keeps track of the heavy hitters.
+ * Memory used is about DEPTH * WIDTH * 2 + TOP_K * 6 bytes.
+ * Counters saturate instead of wrapping around.
+ */
+template <int DEPTH, int WIDTH, int TOP_K>
+class StrokeFrequencySketch {
+
+  struct Entry {
+    unsigned long chord;
+    unsigned int count;
+  };
+
+  unsigned int counters[DEPTH][WIDTH];
+  Entry topStrokes[TOP_K];
+  int topStrokesCount;
+  unsigned long totalStrokes;
+
+  static int hash(const unsigned long chord, const int row) {
+    // Multiplicative hashing with a different odd multiplier per row
+    const unsigned long mixed = (chord ^ (chord >> 15)) * (2654435761UL + 2 * row * 40503UL);
+    return (int) ((mixed >> 16) % WIDTH);
+  }
+
+public:
+
+  StrokeFrequencySketch() {
+    reset();
+  }
+
+  /**
+   * Counts one more occurrence of the given stroke bitmask.
+   */
+  void update(const unsigned long chord) {
+    unsigned int estimate = 0xFFFF;
+    for (int row = 0; row < DEPTH; row++) {
+      unsigned int& counter = counters[row][hash(chord, row)];
+      if (counter < 0xFFFF) {
+        counter++;
+      }
+      if (counter < estimate) {
+        estimate = counter;
+      }
+    }
+    totalStrokes++;
+
+    int minIndex = 0;
+    for (int i = 0; i < topStrokesCount; i++) {
+      if (topStrokes[i].chord == chord) {
+        topStrokes[i].count = estimate;
+        return;
+      }
+      if (topStrokes[i].count < topStrokes[minIndex].count) {
+        minIndex = i;
+      }
+    }
+    if (topStrokesCount < TOP_K) {
+      minIndex = topStrokesCount++;
+    } else if (estimate <= topStrokes[minIndex].count) {
+      return;
+    }
+    topStrokes[minIndex].chord = chord;
+    topStrokes[minIndex].count = estimate;
+  }
+
+  /**
+   * Returns the estimated count of the given stroke bitmask.
+   */
+  unsigned int estimate(const unsigned long chord) const {
+    unsigned int estimate = 0xFFFF;
+    for (int row = 0; row < DEPTH; row++) {
+      const unsigned int counter = counters[row][hash(chord, row)];
+      if (counter < estimate) {
+        estimate = counter;
+      }
+    }
+    return estimate;
+  }
+
+  /**
+   * Forgets all counted strokes.
+   */
+  void reset() {
+    for (int row = 0; row < DEPTH; row++) {
+      for (int column = 0; column < WIDTH; column++) {
+        counters[row][column] = 0;
+      }
+    }
+    topStrokesCount = 0;
+    totalStrokes = 0;
+  }
+
+  /**
+   * Returns the number of strokes counted since the last reset.
+   */
+  unsigned long total() const {
+    return totalStrokes;
+  }
+
+  /**
+   * Returns the number of strokes in the heavy hitters table.
+   */
+  int topStrokeCount() const {
+    return topStrokesCount;
+  }
+
+  /**
+   * Returns the bitmask of the heavy hitter at the given table index.
+   */
+  unsigned long topStroke(const int index) const {
+    return topStrokes[index].chord;
+  }
+
+  /**
+   * Returns the estimated count of the heavy hitter at the given table index.
+   */
+  unsigned int topStrokeEstimate(const int index) const {
+    return topStrokes[index].count;
+  }
+};
+
+#endif // StrokeFrequencySketch_h
@@ -166,13 +166,14 @@ public:
     Keyboard.begin();
   }
 
-  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS]) const {
+  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS], const unsigned long strokeMicros) const {
 
     if (matrixElectronic) {
       sendChordElectronicMatrix(currentChord);
     } else {
       sendChordHapticMatrix(currentChord);
     }
+    strokeSent(strokeMicros);
   }
 };
 
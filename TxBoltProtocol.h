@@ -39,7 +39,7 @@ public:
 //    Serial.begin(9600);
 //  }
 
-  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS]) const {
+  virtual void sendChord(const boolean (&currentChord)[ROWS][COLS], const unsigned long strokeMicros) const {
     byte chordBytes[] = {B0, B0, B0, B0, B0};
     int index = 0;
   
@@ -164,6 +164,7 @@ public:
     for (int i = 0; i < index; i++) {
       Serial.write(chordBytes[i]);
     }
+    strokeSent(strokeMicros);
   }
 };
 
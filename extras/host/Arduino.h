@@ -0,0 +1,43 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * The few Arduino definitions the hardware independent parts
+ * of the firmware need, for building them on the host.
+ * There is deliberately no pin I/O here.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "binary.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+/*
+ * Only declared, for default arguments of the firmware classes.
+ * Host programs pass in mocked clocks instead, or define them.
+ */
+unsigned long millis();
+unsigned long micros();
+
+#endif // Arduino_h
@@ -0,0 +1,135 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Host side of the serial command channel: command names,
+ * and the splitting of the device output into frames and steno data.
+ */
+
+#ifndef CommandStream_h
+#define CommandStream_h
+
+#include <string.h>
+#include "Arduino.h"
+#include "SerialCommandChannel.h"
+
+struct CommandName {
+  const char* name;
+  byte command;
+};
+
+static const CommandName commandNames[] = {
+  {"get-protocol", COMMAND_GET_PROTOCOL},
+  {"set-protocol", COMMAND_SET_PROTOCOL},
+  {"get-debounce", COMMAND_GET_DEBOUNCE},
+  {"set-debounce", COMMAND_SET_DEBOUNCE},
+  {"get-scan-interval", COMMAND_GET_SCAN_INTERVAL},
+  {"set-scan-interval", COMMAND_SET_SCAN_INTERVAL},
+  {"get-emission-mode", COMMAND_GET_EMISSION_MODE},
+  {"set-emission-mode", COMMAND_SET_EMISSION_MODE},
+  {"set-telemetry", COMMAND_SET_TELEMETRY},
+  {"get-hid-stats", COMMAND_GET_HID_STATS},
+  {"get-stroke-stats", COMMAND_GET_STROKE_STATS},
+  {"reset-stroke-stats", COMMAND_RESET_STROKE_STATS},
+  {"get-task-stats", COMMAND_GET_TASK_STATS},
+  {"telemetry", COMMAND_TELEMETRY},
+  {"stroke-stats-entry", COMMAND_STROKE_STATS_ENTRY},
+  {"task-stats-entry", COMMAND_TASK_STATS_ENTRY},
+  {"error", COMMAND_ERROR},
+};
+static const int commandNameCount = sizeof(commandNames) / sizeof(commandNames[0]);
+
+/**
+ * Returns the name of a command, without the COMMAND_REPLY bit, or 0.
+ */
+inline const char* commandName(const byte command) {
+  for (int i = 0; i < commandNameCount; i++) {
+    if (commandNames[i].command == (command & ~COMMAND_REPLY)) {
+      return commandNames[i].name;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Returns the command with the given name, or -1.
+ */
+inline int commandByName(const char* name) {
+  for (int i = 0; i < commandNameCount; i++) {
+    if (strcmp(commandNames[i].name, name) == 0) {
+      return commandNames[i].command;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Splits what the device sends into command channel frames and steno
+ * protocol data. This relies on the frame marker never appearing in the
+ * steno data, which holds for Gemini PR and TX Bolt, but not for the
+ * stroke batch protocol, see SerialCommandChannel.h.
+ */
+class CommandStreamReader {
+
+  SerialCommandChannel channel;
+  /** Bytes of the current frame so far, 0 outside of frames */
+  int frameBytes;
+  int frameSize;
+
+public:
+
+  enum Result { NOTHING, FRAME, BAD_FRAME, DATA };
+
+  CommandStreamReader()
+    : frameBytes(0), frameSize(0)
+  {}
+
+  /**
+   * Feeds one received byte.
+   * @return FRAME if a frame has been completed, which is then in frame(),
+   *   BAD_FRAME if one has been dropped, DATA if the byte is steno data
+   *   and NOTHING for the other bytes of a frame
+   */
+  Result feed(const byte data) {
+    if (frameBytes == 0 && data != COMMAND_FRAME_MARKER) {
+      return DATA;
+    }
+    const boolean isComplete = channel.feed(data);
+    frameBytes++;
+    if (frameBytes == 3) {
+      if (data > COMMAND_MAX_PAYLOAD) {
+        frameBytes = 0;
+        return BAD_FRAME;
+      }
+      frameSize = 4 + data;
+    }
+    if (frameBytes < 3 || frameBytes < frameSize) {
+      return NOTHING;
+    }
+    frameBytes = 0;
+    return isComplete ? FRAME : BAD_FRAME;
+  }
+
+  /** The last complete frame */
+  const SerialCommandChannel& frame() const {
+    return channel;
+  }
+};
+
+#endif // CommandStream_h
@@ -0,0 +1,109 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * A stand in for the Arduino serial port on a file descriptor,
+ * and a pseudo-terminal loopback to connect it to a host side.
+ */
+
+#ifndef HostSerial_h
+#define HostSerial_h
+
+#include <errno.h>
+#include <pty.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "Arduino.h"
+
+class HostSerial {
+public:
+
+  /** The file descriptor written to and read from, -1 discards all output */
+  int fd;
+  /** Number of write calls, each of which is a USB transfer on the device */
+  unsigned long writes;
+  unsigned long writtenBytes;
+
+  HostSerial()
+    : fd(-1), writes(0), writtenBytes(0)
+  {}
+
+  void begin(const long) {}
+
+  size_t write(const byte data) {
+    return write(&data, 1);
+  }
+
+  size_t write(const byte* buffer, const size_t size) {
+    writes++;
+    writtenBytes += size;
+    return writeFully(fd, buffer, size) ? size : 0;
+  }
+
+  int available() {
+    int count = 0;
+    return fd >= 0 && ioctl(fd, FIONREAD, &count) == 0 ? count : 0;
+  }
+
+  int read() {
+    byte data;
+    return fd >= 0 && ::read(fd, &data, 1) == 1 ? data : -1;
+  }
+
+  /**
+   * Writes all bytes, retrying on partial writes.
+   * @return false on an error
+   */
+  static boolean writeFully(const int fd, const byte* buffer, const size_t size) {
+    if (fd < 0) {
+      return true;
+    }
+    size_t written = 0;
+    while (written < size) {
+      const ssize_t count = ::write(fd, buffer + written, size - written);
+      if (count < 0 && errno != EINTR) {
+        return false;
+      }
+      written += count > 0 ? count : 0;
+    }
+    return true;
+  }
+};
+
+extern HostSerial Serial;
+
+/**
+ * Opens a pseudo-terminal pair in raw mode. The device end stands in for
+ * the firmware side of the USB serial port, the host end for the serial
+ * device a host application opens.
+ * @return false if no pseudo-terminal is available
+ */
+inline boolean openSerialLoopback(int& deviceFd, int& hostFd) {
+  if (openpty(&deviceFd, &hostFd, 0, 0, 0) != 0) {
+    return false;
+  }
+  struct termios settings;
+  tcgetattr(hostFd, &settings);
+  cfmakeraw(&settings);
+  tcsetattr(hostFd, TCSANOW, &settings);
+  return true;
+}
+
+#endif // HostSerial_h
@@ -0,0 +1,88 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * A stand in for the Arduino keyboard library,
+ * which only records the reports, for checking them on the host.
+ */
+
+#ifndef Keyboard_h
+#define Keyboard_h
+
+#include "Arduino.h"
+
+#define KEYBOARD_LOG_SIZE 256
+
+class Keyboard_ {
+public:
+
+  /** A sent report: the pressed or released key, 0 for releasing all */
+  struct Report {
+    boolean isPress;
+    byte key;
+    /** The frame clock value when the report was sent */
+    byte frame;
+  };
+
+  /** Returns the frame clock value stored with every report */
+  byte (*frameClock)();
+  Report log[KEYBOARD_LOG_SIZE];
+  int logSize;
+
+  Keyboard_()
+    : frameClock(0), logSize(0)
+  {}
+
+  void begin() {}
+
+  size_t write(const byte key) {
+    press(key);
+    release(key);
+    return 1;
+  }
+
+  size_t press(const byte key) {
+    record(true, key);
+    return 1;
+  }
+
+  size_t release(const byte key) {
+    record(false, key);
+    return 1;
+  }
+
+  void releaseAll() {
+    record(false, 0);
+  }
+
+private:
+
+  void record(const boolean isPress, const byte key) {
+    if (logSize < KEYBOARD_LOG_SIZE) {
+      log[logSize].isPress = isPress;
+      log[logSize].key = key;
+      log[logSize].frame = frameClock != 0 ? frameClock() : 0;
+      logSize++;
+    }
+  }
+};
+
+extern Keyboard_ Keyboard;
+
+#endif // Keyboard_h
@@ -0,0 +1,111 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * The rest of the Arduino API StenoFW.ino uses, for running the whole
+ * sketch on the host:
+ * - the pins emulate the key matrix, with the keys set in sketchKeys held
+ * - Serial is a HostSerial, eg. on a pseudo-terminal
+ * - time is virtual, sketchMicros only advances by delays and by the
+ *   program running the sketch
+ *
+ * This defines the Arduino functions and objects, so it is included by
+ * one source file per program only, ahead of sketch_prototypes.h
+ * (generated from the sketch by the Makefile, as the Arduino IDE does)
+ * and the sketch itself.
+ */
+
+#ifndef Sketch_h
+#define Sketch_h
+
+#include "Arduino.h"
+#include "HostSerial.h"
+#include "Keyboard.h"
+#include "StenoboardKeyboardDefinition.h"
+#include "Protocol.h"
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+HostSerial Serial;
+Keyboard_ Keyboard;
+
+/** The keys currently held */
+boolean sketchKeys[ROWS][COLS];
+unsigned long sketchMicros;
+
+static int sketchPinModes[64];
+static int sketchPinLevels[64];
+
+unsigned long micros() {
+  return sketchMicros;
+}
+
+unsigned long millis() {
+  return sketchMicros / 1000;
+}
+
+void delay(const unsigned long delayMillis) {
+  sketchMicros += delayMillis * 1000;
+}
+
+void delayMicroseconds(const unsigned int delayMicros) {
+  sketchMicros += delayMicros;
+}
+
+void pinMode(const int pin, const int mode) {
+  sketchPinModes[pin] = mode;
+}
+
+void digitalWrite(const int pin, const int level) {
+  sketchPinLevels[pin] = level;
+}
+
+void analogWrite(const int pin, const int value) {
+  sketchPinLevels[pin] = value;
+}
+
+/**
+ * Reads a column low if a held key connects it to a row driven low.
+ */
+int digitalRead(const int pin) {
+  for (int column = 0; column < COLS; column++) {
+    if (colPins[column] != pin) {
+      continue;
+    }
+    if (sketchPinModes[pin] == OUTPUT) {
+      return sketchPinLevels[pin];
+    }
+    for (int row = 0; row < ROWS; row++) {
+      if (sketchKeys[row][column] && sketchPinModes[rowPins[row]] == OUTPUT
+          && sketchPinLevels[rowPins[row]] == LOW) {
+        return LOW;
+      }
+    }
+  }
+  return HIGH;
+}
+
+#endif // Sketch_h
@@ -0,0 +1,254 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Recorded key matrix traces with their expected strokes,
+ * and their replay into a StenoEngine.
+ *
+ * A trace is a text file, with one entry per line:
+ *
+ * # comment
+ * <millis> <keys>          the key matrix reads these keys from then on,
+ *                          "-" if no key is pressed
+ * stroke <millis> <keys>   a stroke the writer meant to write, complete at
+ *                          that time: when its last key was released, or
+ *                          for overlapping strokes when the first key of
+ *                          the next stroke went down
+ *
+ * Times are in milliseconds since the start of the trace, with an optional
+ * fraction for short bounces, and the matrix entries are in time order.
+ * The trace is replayed up to its last matrix entry,
+ * so traces end with all keys released.
+ * Keys are named after the KEY_ constants of the keyboard definition:
+ * S1 T P H STAR1 FN1 S2 K W R STAR2 FN2 a o e u SHARP f p l t d r b g s z
+ */
+
+#ifndef StrokeTrace_h
+#define StrokeTrace_h
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "StenoboardKeyboardDefinition.h"
+#include "StenoEngine.h"
+#include "ChordBitmask.h"
+
+/** Key matrix scan interval used for replays, as in the firmware */
+#define TRACE_SCAN_MICROS 200UL
+
+/** Keys and the time they refer to, as a chord bitmask */
+struct TraceStroke {
+  unsigned long micros;
+  unsigned long keys;
+};
+
+struct Trace {
+  std::string name;
+  /** Key matrix states, each holding until the next one */
+  std::vector<TraceStroke> matrix;
+  /** The strokes the writer meant to write */
+  std::vector<TraceStroke> strokes;
+};
+
+struct TraceKeyName {
+  const char* name;
+  int row;
+  int column;
+};
+
+static const TraceKeyName traceKeyNames[] = {
+  {"S1", KEY_S1_D0, KEY_S1_D1}, {"T", KEY_T_D0, KEY_T_D1},
+  {"P", KEY_P_D0, KEY_P_D1}, {"H", KEY_H_D0, KEY_H_D1},
+  {"STAR1", KEY_STAR1_D0, KEY_STAR1_D1}, {"FN1", KEY_FN1_D0, KEY_FN1_D1},
+  {"S2", KEY_S2_D0, KEY_S2_D1}, {"K", KEY_K_D0, KEY_K_D1},
+  {"W", KEY_W_D0, KEY_W_D1}, {"R", KEY_R_D0, KEY_R_D1},
+  {"STAR2", KEY_STAR2_D0, KEY_STAR2_D1}, {"FN2", KEY_FN2_D0, KEY_FN2_D1},
+  {"a", KEY_a_D0, KEY_a_D1}, {"o", KEY_o_D0, KEY_o_D1},
+  {"e", KEY_e_D0, KEY_e_D1}, {"u", KEY_u_D0, KEY_u_D1},
+  {"SHARP", KEY_SHARP_D0, KEY_SHARP_D1},
+  {"f", KEY_f_D0, KEY_f_D1}, {"p", KEY_p_D0, KEY_p_D1},
+  {"l", KEY_l_D0, KEY_l_D1}, {"t", KEY_t_D0, KEY_t_D1},
+  {"d", KEY_d_D0, KEY_d_D1},
+  {"r", KEY_r_D0, KEY_r_D1}, {"b", KEY_b_D0, KEY_b_D1},
+  {"g", KEY_g_D0, KEY_g_D1}, {"s", KEY_s_D0, KEY_s_D1},
+  {"z", KEY_z_D0, KEY_z_D1},
+};
+static const int traceKeyNameCount = sizeof(traceKeyNames) / sizeof(traceKeyNames[0]);
+
+/**
+ * Returns the chord bitmask bit of the named key, or 0 if it is unknown.
+ */
+inline unsigned long traceKeyBit(const char* name) {
+  for (int i = 0; i < traceKeyNameCount; i++) {
+    if (strcmp(traceKeyNames[i].name, name) == 0) {
+      return 1UL << (traceKeyNames[i].row * COLS + traceKeyNames[i].column);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Returns the names of the keys in the chord bitmask, separated by spaces.
+ */
+inline std::string traceKeysToString(const unsigned long keys) {
+  std::string names;
+  for (int i = 0; i < traceKeyNameCount; i++) {
+    if (keys & (1UL << (traceKeyNames[i].row * COLS + traceKeyNames[i].column))) {
+      if (!names.empty()) {
+        names += ' ';
+      }
+      names += traceKeyNames[i].name;
+    }
+  }
+  return names.empty() ? "-" : names;
+}
+
+/**
+ * Parses a time and the key names following it.
+ * @return false if the line is malformed
+ */
+inline boolean parseTraceEntry(char* text, TraceStroke& entry) {
+  char* token = strtok(text, " \t\r\n");
+  char* end;
+  const double millis = token != 0 ? strtod(token, &end) : -1;
+  if (token == 0 || *end != '\0' || millis < 0) {
+    return false;
+  }
+  entry.micros = (unsigned long) (millis * 1000 + 0.5);
+  entry.keys = 0;
+  while ((token = strtok(0, " \t\r\n")) != 0) {
+    if (strcmp(token, "-") == 0) {
+      continue;
+    }
+    const unsigned long bit = traceKeyBit(token);
+    if (bit == 0) {
+      return false;
+    }
+    entry.keys |= bit;
+  }
+  return true;
+}
+
+/**
+ * Loads a trace file, printing the first error to stderr.
+ * @return false if the file cannot be read or is malformed
+ */
+inline boolean loadTrace(const char* path, Trace& trace) {
+  FILE* file = fopen(path, "r");
+  if (file == 0) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+  const char* slash = strrchr(path, '/');
+  trace.name = slash != 0 ? slash + 1 : path;
+  trace.matrix.clear();
+  trace.strokes.clear();
+  char line[256];
+  int lineNumber = 0;
+  boolean isOk = true;
+  while (isOk && fgets(line, sizeof(line), file) != 0) {
+    lineNumber++;
+    char* text = line + strspn(line, " \t");
+    if (*text == '#' || strspn(text, " \t\r\n") == strlen(text)) {
+      continue;
+    }
+    TraceStroke entry;
+    if (strncmp(text, "stroke", 6) == 0) {
+      isOk = parseTraceEntry(text + 6, entry) && entry.keys != 0;
+      trace.strokes.push_back(entry);
+    } else {
+      isOk = parseTraceEntry(text, entry)
+          && (trace.matrix.empty() || entry.micros >= trace.matrix.back().micros);
+      trace.matrix.push_back(entry);
+    }
+  }
+  fclose(file);
+  if (!isOk) {
+    fprintf(stderr, "%s:%d: malformed entry\n", path, lineNumber);
+  } else if (trace.matrix.empty()) {
+    fprintf(stderr, "%s: no key matrix entries\n", path);
+    isOk = false;
+  }
+  return isOk;
+}
+
+/**
+ * Loads all *.trace files of a directory, in name order.
+ * @return false if the directory cannot be read, or a trace is malformed
+ */
+inline boolean loadTraces(const char* directory, std::vector<Trace>& traces) {
+  DIR* dir = opendir(directory);
+  if (dir == 0) {
+    fprintf(stderr, "%s: cannot open directory\n", directory);
+    return false;
+  }
+  std::vector<std::string> paths;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != 0) {
+    const size_t length = strlen(entry->d_name);
+    if (length > 6 && strcmp(entry->d_name + length - 6, ".trace") == 0) {
+      paths.push_back(std::string(directory) + "/" + entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(paths.begin(), paths.end());
+  boolean isOk = true;
+  for (size_t i = 0; i < paths.size(); i++) {
+    Trace trace;
+    if (loadTrace(paths[i].c_str(), trace)) {
+      traces.push_back(trace);
+    } else {
+      isOk = false;
+    }
+  }
+  return isOk;
+}
+
+/**
+ * Replays a trace into the engine, scanning every TRACE_SCAN_MICROS,
+ * and returns the strokes it finished, at their StenoEngine::strokeMicros.
+ */
+inline std::vector<TraceStroke> replayTrace(StenoEngine& engine, const Trace& trace) {
+  std::vector<TraceStroke> strokes;
+  boolean readings[ROWS][COLS];
+  size_t step = 0;
+  for (unsigned long micros = trace.matrix.front().micros;
+      micros <= trace.matrix.back().micros; micros += TRACE_SCAN_MICROS) {
+    while (step + 1 < trace.matrix.size() && trace.matrix[step + 1].micros <= micros) {
+      step++;
+    }
+    for (int row = 0; row < ROWS; row++) {
+      for (int column = 0; column < COLS; column++) {
+        readings[row][column] = (trace.matrix[step].keys >> (row * COLS + column)) & 1;
+      }
+    }
+    if (engine.update(readings, micros)) {
+      TraceStroke stroke = {engine.strokeMicros, chordToBitmask(engine.stroke)};
+      strokes.push_back(stroke);
+    }
+  }
+  return strokes;
+}
+
+#endif // StrokeTrace_h
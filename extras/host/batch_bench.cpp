@@ -0,0 +1,179 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Compares the throughput of the Gemini PR, TX Bolt and stroke batch
+ * protocols on a pseudo-terminal loopback. The firmware protocol classes
+ * write a burst of strokes into the device end, and the host end reads
+ * and decodes them.
+ *
+ * A pseudo-terminal is limited by the CPU rather than by a baud rate,
+ * so the bytes and writes per stroke are reported as well, with the
+ * resulting limit on a 9600 baud 8N1 line as used by the firmware.
+ *
+ * Usage: batch_bench [trace directory] [strokes]
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <thread>
+#include "Arduino.h"
+#include "HostSerial.h"
+#include "StrokeTrace.h"
+#include "GeminiProtocol.h"
+#include "TxBoltProtocol.h"
+#include "StrokeBatchProtocol.h"
+
+HostSerial Serial;
+
+static double nowSeconds() {
+  struct timeval now;
+  gettimeofday(&now, 0);
+  return now.tv_sec + now.tv_usec / 1e6;
+}
+
+unsigned long millis() {
+  return (unsigned long) (nowSeconds() * 1000);
+}
+
+/** Counts the strokes in the bytes received by the host */
+class StrokeCounter {
+public:
+  virtual ~StrokeCounter() {}
+  virtual unsigned long feed(const byte data) = 0;
+};
+
+/** Gemini PR packets are 6 bytes, the first one with the high bit set */
+class GeminiCounter : public StrokeCounter {
+  virtual unsigned long feed(const byte data) {
+    return (data & 0x80) ? 1 : 0;
+  }
+};
+
+/** The firmware ends every TX Bolt packet with a zero byte */
+class TxBoltCounter : public StrokeCounter {
+  virtual unsigned long feed(const byte data) {
+    return data == 0 ? 1 : 0;
+  }
+};
+
+class StrokeBatchCounter : public StrokeCounter {
+  StrokeBatchDecoder decoder;
+  virtual unsigned long feed(const byte data) {
+    unsigned long strokes = 0;
+    for (int count = decoder.feed(data); count > 0; count = decoder.poll()) {
+      strokes += count;
+    }
+    return strokes;
+  }
+};
+
+/**
+ * Sends the strokes through the protocol into the loopback,
+ * and reads them back on the host end.
+ * @return false if not all strokes arrived
+ */
+static boolean bench(const char* name, Protocol& protocol, StrokeCounter& counter,
+    const std::vector<unsigned long>& strokes) {
+  int deviceFd;
+  int hostFd;
+  if (!openSerialLoopback(deviceFd, hostFd)) {
+    fprintf(stderr, "%s: no pseudo-terminal available\n", name);
+    return false;
+  }
+  Serial.fd = deviceFd;
+  Serial.writes = 0;
+  Serial.writtenBytes = 0;
+
+  const double startSeconds = nowSeconds();
+  std::thread device([&]() {
+    boolean chord[ROWS][COLS];
+    for (size_t i = 0; i < strokes.size(); i++) {
+      for (int row = 0; row < ROWS; row++) {
+        for (int column = 0; column < COLS; column++) {
+          chord[row][column] = (strokes[i] >> (row * COLS + column)) & 1;
+        }
+      }
+      protocol.sendChord(chord, 0);
+      protocol.update();
+    }
+    protocol.flush();
+  });
+
+  unsigned long receivedStrokes = 0;
+  byte buffer[4096];
+  struct pollfd readable = {hostFd, POLLIN, 0};
+  while (receivedStrokes < strokes.size() && poll(&readable, 1, 1000) > 0) {
+    const ssize_t count = read(hostFd, buffer, sizeof(buffer));
+    for (ssize_t i = 0; i < count; i++) {
+      receivedStrokes += counter.feed(buffer[i]);
+    }
+  }
+  const double seconds = nowSeconds() - startSeconds;
+  device.join();
+  close(deviceFd);
+  close(hostFd);
+
+  const double bytesPerStroke = (double) Serial.writtenBytes / strokes.size();
+  printf("%-12s %8.2f %8.2f %12.0f %12.0f  %s\n", name, bytesPerStroke,
+      (double) Serial.writes / strokes.size(), receivedStrokes / seconds,
+      960 / bytesPerStroke, receivedStrokes == strokes.size() ? "ok" : "FAILED");
+  return receivedStrokes == strokes.size();
+}
+
+int main(int argc, char** argv) {
+  const char* directory = argc > 1 ? argv[1] : "traces";
+  const unsigned long strokeCount = argc > 2 ? strtoul(argv[2], 0, 10) : 20000;
+
+  // Repeats the expected strokes of the trace corpus
+  std::vector<Trace> traces;
+  if (!loadTraces(directory, traces)) {
+    return 1;
+  }
+  std::vector<unsigned long> corpus;
+  for (size_t i = 0; i < traces.size(); i++) {
+    for (size_t j = 0; j < traces[i].strokes.size(); j++) {
+      corpus.push_back(traces[i].strokes[j].keys);
+    }
+  }
+  if (corpus.empty()) {
+    fprintf(stderr, "%s: no strokes\n", directory);
+    return 1;
+  }
+  std::vector<unsigned long> strokes;
+  for (unsigned long i = 0; i < strokeCount; i++) {
+    strokes.push_back(corpus[i % corpus.size()]);
+  }
+
+  printf("%lu strokes\n", strokeCount);
+  printf("%-12s %8s %8s %12s %12s\n", "protocol", "bytes", "writes", "strokes/s", "at 9600 bd");
+  GeminiProtocol gemini;
+  GeminiCounter geminiCounter;
+  TxBoltProtocol txBolt;
+  TxBoltCounter txBoltCounter;
+  StrokeBatchProtocol strokeBatch;
+  StrokeBatchCounter strokeBatchCounter;
+  int failures = 0;
+  failures += bench("Gemini PR", gemini, geminiCounter, strokes) ? 0 : 1;
+  failures += bench("TX Bolt", txBolt, txBoltCounter, strokes) ? 0 : 1;
+  failures += bench("stroke batch", strokeBatch, strokeBatchCounter, strokes) ? 0 : 1;
+  return failures;
+}
@@ -0,0 +1,160 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Checks the stroke batch encoder and the host decoder:
+ * round trips, resync after corrupt bytes, packets recovered
+ * from a false sync byte, and the counting of lost packets.
+ */
+
+#include <stdio.h>
+#include <vector>
+#include "Arduino.h"
+#include "StrokeBatchCodec.h"
+
+typedef std::vector<uint8_t> Bytes;
+typedef std::vector<uint32_t> Strokes;
+
+static uint32_t randomState = 12345;
+
+/** A deterministic stroke, with up to 30 keys in use */
+static uint32_t randomStroke() {
+  randomState = randomState * 1103515245 + 12345;
+  return (randomState >> 2) & 0x3FFFFFFF;
+}
+
+static void appendPacket(Bytes& stream, const uint8_t sequence, const Strokes& strokes) {
+  uint8_t packet[STROKE_BATCH_MAX_PACKET_SIZE];
+  const int size = strokeBatchEncode(packet, sequence, &strokes[0], (int) strokes.size());
+  stream.insert(stream.end(), packet, packet + size);
+}
+
+/**
+ * Decodes a whole stream, the way the decoder documentation asks for.
+ */
+static Strokes decodeAll(StrokeBatchDecoder& decoder, const Bytes& stream) {
+  Strokes strokes;
+  for (size_t i = 0; i < stream.size(); i++) {
+    for (int count = decoder.feed(stream[i]); count > 0; count = decoder.poll()) {
+      strokes.insert(strokes.end(), decoder.strokes, decoder.strokes + count);
+    }
+  }
+  return strokes;
+}
+
+static int check(const char* name, const boolean isOk) {
+  printf("%s -> %s\n", name, isOk ? "ok" : "FAILED");
+  return isOk ? 0 : 1;
+}
+
+/**
+ * Encodes packets of 1 up to STROKE_BATCH_MAX_STROKES random strokes,
+ * and returns the stream and all strokes.
+ */
+static Bytes buildStream(const int packetCount, std::vector<Strokes>& packets) {
+  Bytes stream;
+  for (int i = 0; i < packetCount; i++) {
+    Strokes strokes;
+    for (int j = 0; j <= i % STROKE_BATCH_MAX_STROKES; j++) {
+      strokes.push_back(randomStroke());
+    }
+    packets.push_back(strokes);
+    appendPacket(stream, (uint8_t) i, strokes);
+  }
+  return stream;
+}
+
+static Strokes join(const std::vector<Strokes>& packets, const int skippedPacket) {
+  Strokes strokes;
+  for (int i = 0; i < (int) packets.size(); i++) {
+    if (i != skippedPacket) {
+      strokes.insert(strokes.end(), packets[i].begin(), packets[i].end());
+    }
+  }
+  return strokes;
+}
+
+int main() {
+  int failures = 0;
+
+  // Round trip over a sequence number wrap
+  {
+    std::vector<Strokes> packets;
+    const Bytes stream = buildStream(300, packets);
+    StrokeBatchDecoder decoder;
+    const Strokes strokes = decodeAll(decoder, stream);
+    failures += check("round trip", strokes == join(packets, -1)
+        && decoder.corruptPackets == 0 && decoder.lostPackets == 0);
+  }
+
+  // A corrupt byte in one packet, and noise with sync bytes between two others
+  {
+    std::vector<Strokes> packets;
+    Bytes stream = buildStream(20, packets);
+    size_t offset = 0;
+    for (int i = 0; i < 5; i++) {
+      offset += STROKE_BATCH_HEADER_SIZE + stream[offset + 3] + 1;
+    }
+    stream[offset + STROKE_BATCH_HEADER_SIZE] ^= 0x5A;
+    offset += STROKE_BATCH_HEADER_SIZE + stream[offset + 3] + 1;
+    const uint8_t noise[] = {STROKE_BATCH_SYNC, 0x07, 0x02, STROKE_BATCH_SYNC, 0x01};
+    stream.insert(stream.begin() + offset, noise, noise + sizeof(noise));
+    StrokeBatchDecoder decoder;
+    const Strokes strokes = decodeAll(decoder, stream);
+    failures += check("resync after corruption", strokes == join(packets, 5)
+        && decoder.corruptPackets >= 2 && decoder.lostPackets == 1);
+  }
+
+  // A false sync byte whose frame covers two complete one stroke packets.
+  // Both are only found by rescanning, after the last byte of the stream.
+  {
+    Bytes stream;
+    const uint8_t falseHeader[] = {STROKE_BATCH_SYNC, 0x10, 0x01, 0x0D};
+    stream.insert(stream.end(), falseHeader, falseHeader + sizeof(falseHeader));
+    appendPacket(stream, 0, Strokes(1, 0x123));
+    appendPacket(stream, 1, Strokes(1, 0x456));
+    StrokeBatchDecoder decoder;
+    const Strokes strokes = decodeAll(decoder, stream);
+    Strokes expected;
+    expected.push_back(0x123);
+    expected.push_back(0x456);
+    failures += check("packets recovered from a false sync", strokes == expected
+        && decoder.corruptPackets == 1);
+  }
+
+  // Two packets missing from the sequence
+  {
+    std::vector<Strokes> packets;
+    const Bytes stream = buildStream(10, packets);
+    Bytes gappy;
+    size_t offset = 0;
+    for (int i = 0; i < 10; i++) {
+      const size_t size = STROKE_BATCH_HEADER_SIZE + stream[offset + 3] + 1;
+      if (i != 3 && i != 7) {
+        gappy.insert(gappy.end(), stream.begin() + offset, stream.begin() + offset + size);
+      }
+      offset += size;
+    }
+    StrokeBatchDecoder decoder;
+    decodeAll(decoder, gappy);
+    failures += check("sequence loss", decoder.lostPackets == 2 && decoder.corruptPackets == 0);
+  }
+
+  return failures;
+}
@@ -0,0 +1,223 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Encodes, decodes and sends serial command channel frames.
+ *
+ * Usage:
+ *   command_cli encode <command> [payload byte ...]
+ *     prints the frame in hex
+ *   command_cli decode [byte ...]
+ *     decodes device output given in hex, from the arguments or stdin
+ *   command_cli send <serial device> <command> [payload byte ...]
+ *     sends the frame and prints what the device sends back
+ *     until it is quiet for half a second
+ *
+ * Commands are given by name (eg. get-debounce) or number,
+ * payload bytes as decimal or 0x prefixed hex numbers.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Arduino.h"
+#include "HostSerial.h"
+#include "CommandStream.h"
+
+HostSerial Serial;
+
+static int parseByte(const char* text) {
+  char* end;
+  const long value = strtol(text, &end, 0);
+  return *end == '\0' && value >= 0 && value <= 0xFF ? (int) value : -1;
+}
+
+/**
+ * Parses the command and payload arguments.
+ * @return false if they are malformed
+ */
+static boolean parseCommand(int argc, char** argv, byte& command, byte* payload, byte& length) {
+  if (argc < 1) {
+    return false;
+  }
+  int value = commandByName(argv[0]);
+  if (value < 0) {
+    value = parseByte(argv[0]);
+  }
+  if (value < 0 || argc - 1 > COMMAND_MAX_PAYLOAD) {
+    return false;
+  }
+  command = value;
+  length = argc - 1;
+  for (int i = 0; i < length; i++) {
+    value = parseByte(argv[1 + i]);
+    if (value < 0) {
+      return false;
+    }
+    payload[i] = value;
+  }
+  return true;
+}
+
+static const char* const errorNames[] = {"", "unknown command", "bad payload", "bad value"};
+
+static void printFrame(const SerialCommandChannel& frame) {
+  const char* name = commandName(frame.command);
+  if (frame.command == COMMAND_ERROR && frame.length == 2) {
+    const char* failed = commandName(frame.payload[0]);
+    printf("error %s: ", failed != 0 ? failed : "?");
+    printf("%s\n", frame.payload[1] <= COMMAND_ERROR_BAD_VALUE ? errorNames[frame.payload[1]] : "?");
+    return;
+  }
+  printf("%s%s", (frame.command & COMMAND_REPLY) ? "reply " : "", name != 0 ? name : "?");
+  if (name == 0) {
+    printf(" 0x%02X", frame.command);
+  }
+  printf(":");
+  for (int i = 0; i < frame.length; i++) {
+    printf(" %02X", frame.payload[i]);
+  }
+  printf("\n");
+}
+
+/**
+ * Prints the frames in the device output, and a summary of the steno data.
+ */
+class OutputPrinter {
+  CommandStreamReader reader;
+  unsigned long dataBytes;
+
+public:
+
+  OutputPrinter()
+    : dataBytes(0)
+  {}
+
+  void feed(const byte data) {
+    const CommandStreamReader::Result result = reader.feed(data);
+    if (result == CommandStreamReader::DATA) {
+      dataBytes++;
+      return;
+    }
+    if (result != CommandStreamReader::NOTHING && dataBytes > 0) {
+      printf("(%lu bytes of steno data)\n", dataBytes);
+      dataBytes = 0;
+    }
+    if (result == CommandStreamReader::FRAME) {
+      printFrame(reader.frame());
+    } else if (result == CommandStreamReader::BAD_FRAME) {
+      printf("(dropped a frame with a bad length or CRC)\n");
+    }
+  }
+
+  void finish() {
+    if (dataBytes > 0) {
+      printf("(%lu bytes of steno data)\n", dataBytes);
+      dataBytes = 0;
+    }
+  }
+};
+
+static int encode(int argc, char** argv) {
+  byte command;
+  byte payload[COMMAND_MAX_PAYLOAD];
+  byte length;
+  if (!parseCommand(argc, argv, command, payload, length)) {
+    fprintf(stderr, "bad command or payload\n");
+    return 2;
+  }
+  byte crc = crc8Update(crc8Update(0, command), length);
+  printf("%02X %02X %02X", COMMAND_FRAME_MARKER, command, length);
+  for (int i = 0; i < length; i++) {
+    printf(" %02X", payload[i]);
+    crc = crc8Update(crc, payload[i]);
+  }
+  printf(" %02X\n", crc);
+  return 0;
+}
+
+static int decode(int argc, char** argv) {
+  OutputPrinter printer;
+  char text[16];
+  for (int i = 0; argc > 0 ? i < argc : scanf("%15s", text) == 1; i++) {
+    const long value = strtol(argc > 0 ? argv[i] : text, 0, 16);
+    if (value < 0 || value > 0xFF) {
+      fprintf(stderr, "bad byte: %s\n", argc > 0 ? argv[i] : text);
+      return 2;
+    }
+    printer.feed((byte) value);
+  }
+  printer.finish();
+  return 0;
+}
+
+static int send(int argc, char** argv) {
+  byte command;
+  byte payload[COMMAND_MAX_PAYLOAD];
+  byte length;
+  if (argc < 2 || !parseCommand(argc - 1, argv + 1, command, payload, length)) {
+    fprintf(stderr, "bad device, command or payload\n");
+    return 2;
+  }
+  const int fd = open(argv[0], O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    perror(argv[0]);
+    return 1;
+  }
+  struct termios settings;
+  if (tcgetattr(fd, &settings) == 0) {
+    cfmakeraw(&settings);
+    tcsetattr(fd, TCSANOW, &settings);
+  }
+  Serial.fd = fd;
+  SerialCommandChannel::send(command, payload, length);
+
+  OutputPrinter printer;
+  byte buffer[256];
+  struct pollfd readable = {fd, POLLIN, 0};
+  while (poll(&readable, 1, 500) > 0) {
+    const ssize_t count = read(fd, buffer, sizeof(buffer));
+    if (count <= 0) {
+      break;
+    }
+    for (ssize_t i = 0; i < count; i++) {
+      printer.feed(buffer[i]);
+    }
+  }
+  printer.finish();
+  close(fd);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "encode") == 0) {
+    return encode(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && strcmp(argv[1], "decode") == 0) {
+    return decode(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && strcmp(argv[1], "send") == 0) {
+    return send(argc - 2, argv + 2);
+  }
+  fprintf(stderr, "usage: %s encode <command> [payload byte ...]\n"
+      "       %s decode [byte ...]\n"
+      "       %s send <serial device> <command> [payload byte ...]\n", argv[0], argv[0], argv[0]);
+  return 2;
+}
@@ -0,0 +1,256 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Runs the whole sketch on the device end of a pseudo-terminal pair,
+ * and talks to its serial command channel from the host end, while keys
+ * are written so Gemini PR packets are interleaved on the same stream.
+ * Checks get and set round trips, error replies, and that the parser
+ * resyncs after a frame with a bad CRC.
+ */
+
+#include <poll.h>
+#include <stdio.h>
+#include <vector>
+#include "Arduino.h"
+#include "HostSerial.h"
+#include "CommandStream.h"
+#include "Sketch.h"
+#include "sketch_prototypes.h"
+#include "StenoFW.ino"
+
+typedef std::vector<byte> Bytes;
+
+struct Frame {
+  byte command;
+  Bytes payload;
+
+  bool operator==(const Frame& other) const {
+    return command == other.command && payload == other.payload;
+  }
+};
+
+static int hostFd;
+static CommandStreamReader reader;
+static std::vector<Frame> frames;
+static std::vector<Bytes> geminiPackets;
+static Bytes geminiPacket;
+static unsigned long badFrames;
+
+/**
+ * Reads everything the sketch has sent so far,
+ * splitting it into frames and Gemini PR packets.
+ */
+static void readHost() {
+  byte buffer[256];
+  struct pollfd readable = {hostFd, POLLIN, 0};
+  while (poll(&readable, 1, 0) > 0) {
+    const ssize_t count = read(hostFd, buffer, sizeof(buffer));
+    for (ssize_t i = 0; i < count; i++) {
+      switch (reader.feed(buffer[i])) {
+      case CommandStreamReader::FRAME: {
+        const SerialCommandChannel& channel = reader.frame();
+        Frame received = {channel.command, Bytes(channel.payload, channel.payload + channel.length)};
+        frames.push_back(received);
+        break;
+      }
+      case CommandStreamReader::BAD_FRAME:
+        badFrames++;
+        break;
+      case CommandStreamReader::DATA:
+        if (buffer[i] & 0x80) {
+          geminiPacket.clear();
+        }
+        geminiPacket.push_back(buffer[i]);
+        if (geminiPacket.size() == 6) {
+          geminiPackets.push_back(geminiPacket);
+        }
+        break;
+      case CommandStreamReader::NOTHING:
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * Runs the sketch for the given time, with one loop() every 50 us.
+ */
+static void run(const unsigned long millis) {
+  const unsigned long endMicros = sketchMicros + millis * 1000;
+  while (sketchMicros < endMicros) {
+    loop();
+    sketchMicros += 50;
+    readHost();
+  }
+}
+
+static Bytes encodeFrame(const byte command, const Bytes& payload) {
+  Bytes frame;
+  frame.push_back(COMMAND_FRAME_MARKER);
+  frame.push_back(command);
+  frame.push_back((byte) payload.size());
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  byte crc = 0;
+  for (size_t i = 1; i < frame.size(); i++) {
+    crc = crc8Update(crc, frame[i]);
+  }
+  frame.push_back(crc);
+  return frame;
+}
+
+static void sendHost(const Bytes& bytes) {
+  HostSerial::writeFully(hostFd, &bytes[0], bytes.size());
+}
+
+static Bytes bytes(const int count, const byte first = 0, const byte second = 0) {
+  Bytes result;
+  if (count > 0) {
+    result.push_back(first);
+  }
+  if (count > 1) {
+    result.push_back(second);
+  }
+  return result;
+}
+
+static Frame frame(const byte command, const Bytes& payload) {
+  Frame result = {command, payload};
+  return result;
+}
+
+/**
+ * Sends a command, runs the sketch and compares the frames it sent back.
+ */
+static int check(const char* name, const Bytes& sent, const std::vector<Frame>& expected) {
+  frames.clear();
+  sendHost(sent);
+  run(20);
+  const boolean isOk = frames == expected;
+  printf("%s -> %s\n", name, isOk ? "ok" : "FAILED");
+  if (!isOk) {
+    for (size_t i = 0; i < frames.size(); i++) {
+      printf("  got %02X:", frames[i].command);
+      for (size_t j = 0; j < frames[i].payload.size(); j++) {
+        printf(" %02X", frames[i].payload[j]);
+      }
+      printf("\n");
+    }
+  }
+  return isOk ? 0 : 1;
+}
+
+static int check(const char* name, const byte command, const Bytes& payload, const Frame& expected) {
+  return check(name, encodeFrame(command, payload), std::vector<Frame>(1, expected));
+}
+
+static Frame error(const byte command, const byte errorCode) {
+  return frame(COMMAND_ERROR, bytes(2, command, errorCode));
+}
+
+static int checkCondition(const char* name, const boolean isOk) {
+  printf("%s -> %s\n", name, isOk ? "ok" : "FAILED");
+  return isOk ? 0 : 1;
+}
+
+int main() {
+  int deviceFd;
+  if (!openSerialLoopback(deviceFd, hostFd)) {
+    fprintf(stderr, "no pseudo-terminal available\n");
+    return 1;
+  }
+  Serial.fd = deviceFd;
+  setup();
+  run(10);
+
+  int failures = 0;
+  failures += check("set protocol", COMMAND_SET_PROTOCOL, bytes(1, 2),
+      frame(COMMAND_SET_PROTOCOL | COMMAND_REPLY, bytes(1, 2)));
+  failures += check("get protocol", COMMAND_GET_PROTOCOL, bytes(0),
+      frame(COMMAND_GET_PROTOCOL | COMMAND_REPLY, bytes(1, 2)));
+
+  // TP- is written while a command is being received and answered
+  sketchKeys[KEY_T_D0][KEY_T_D1] = true;
+  sketchKeys[KEY_P_D0][KEY_P_D1] = true;
+  failures += check("get debounce while writing", COMMAND_GET_DEBOUNCE, bytes(0),
+      frame(COMMAND_GET_DEBOUNCE | COMMAND_REPLY, bytes(1, debounceMillis)));
+  run(30);
+  sketchKeys[KEY_T_D0][KEY_T_D1] = false;
+  sketchKeys[KEY_P_D0][KEY_P_D1] = false;
+  run(10);
+  const byte tp[] = {0x80, 0x14, 0, 0, 0, 0};
+  failures += checkCondition("Gemini packet in between frames",
+      geminiPackets.size() == 1 && geminiPackets[0] == Bytes(tp, tp + 6));
+
+  failures += check("set debounce", COMMAND_SET_DEBOUNCE, bytes(1, 30),
+      frame(COMMAND_SET_DEBOUNCE | COMMAND_REPLY, bytes(1, 30)));
+  failures += check("get debounce", COMMAND_GET_DEBOUNCE, bytes(0),
+      frame(COMMAND_GET_DEBOUNCE | COMMAND_REPLY, bytes(1, 30)));
+  failures += check("set scan interval above 0x8000", COMMAND_SET_SCAN_INTERVAL, bytes(2, 0x40, 0x9C),
+      frame(COMMAND_SET_SCAN_INTERVAL | COMMAND_REPLY, bytes(2, 0x40, 0x9C)));
+  failures += checkCondition("scan interval value", scanIntervalMicros == 40000);
+  failures += check("set scan interval", COMMAND_SET_SCAN_INTERVAL, bytes(2, 0, 0),
+      frame(COMMAND_SET_SCAN_INTERVAL | COMMAND_REPLY, bytes(2, 0, 0)));
+  failures += check("set emission mode", COMMAND_SET_EMISSION_MODE, bytes(1, EMISSION_MODE_ON_RELEASE),
+      frame(COMMAND_SET_EMISSION_MODE | COMMAND_REPLY, bytes(1, EMISSION_MODE_ON_RELEASE)));
+  failures += check("get emission mode", COMMAND_GET_EMISSION_MODE, bytes(0),
+      frame(COMMAND_GET_EMISSION_MODE | COMMAND_REPLY, bytes(1, EMISSION_MODE_ON_RELEASE)));
+
+  failures += check("bad payload", COMMAND_SET_DEBOUNCE, bytes(2, 30, 0),
+      error(COMMAND_SET_DEBOUNCE, COMMAND_ERROR_BAD_PAYLOAD));
+  failures += check("unknown command with payload", 0x33, bytes(1, 1),
+      error(0x33, COMMAND_ERROR_UNKNOWN_COMMAND));
+  failures += check("unknown command", 0x33, bytes(0),
+      error(0x33, COMMAND_ERROR_UNKNOWN_COMMAND));
+  failures += check("bad value", COMMAND_SET_PROTOCOL, bytes(1, 9),
+      error(COMMAND_SET_PROTOCOL, COMMAND_ERROR_BAD_VALUE));
+
+  // A frame with a bad CRC and a stray byte, directly followed by a good
+  // frame, while S- is written
+  sketchKeys[KEY_S1_D0][KEY_S1_D1] = true;
+  Bytes corrupt = encodeFrame(COMMAND_SET_DEBOUNCE, bytes(1, 5));
+  corrupt.back() ^= 0x01;
+  corrupt.push_back(0x00);
+  const Bytes good = encodeFrame(COMMAND_GET_DEBOUNCE, bytes(0));
+  corrupt.insert(corrupt.end(), good.begin(), good.end());
+  failures += check("resync after a bad CRC", corrupt,
+      std::vector<Frame>(1, frame(COMMAND_GET_DEBOUNCE | COMMAND_REPLY, bytes(1, 30))));
+  failures += checkCondition("bad CRC dropped", commandChannel.droppedFrames == 1);
+  run(30);
+  sketchKeys[KEY_S1_D0][KEY_S1_D1] = false;
+  run(10);
+  const byte s[] = {0x80, 0x40, 0, 0, 0, 0};
+  failures += checkCondition("second Gemini packet",
+      geminiPackets.size() == 2 && geminiPackets[1] == Bytes(s, s + 6));
+
+  // Telemetry follows the Gemini packet of the next stroke
+  failures += check("set telemetry", COMMAND_SET_TELEMETRY, bytes(1, 1),
+      frame(COMMAND_SET_TELEMETRY | COMMAND_REPLY, bytes(1, 1)));
+  frames.clear();
+  sketchKeys[KEY_a_D0][KEY_a_D1] = true;
+  run(40);
+  sketchKeys[KEY_a_D0][KEY_a_D1] = false;
+  run(10);
+  failures += checkCondition("telemetry after the stroke", geminiPackets.size() == 3
+      && frames.size() == 1 && frames[0].command == COMMAND_TELEMETRY
+      && frames[0].payload.size() == 4);
+
+  failures += checkCondition("no bad frames from the device", badFrames == 0);
+  return failures;
+}
@@ -0,0 +1,81 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Builds StenoEngine on the host, without any Arduino hardware access,
+ * and replays the recorded traces of a directory (default: traces).
+ * With the default settings, every trace has to give exactly its expected
+ * strokes. A second engine with different settings runs side by side
+ * on one of the traces.
+ *
+ * Usage: engine_host [trace directory]
+ */
+
+#include <stdio.h>
+#include "StrokeTrace.h"
+
+/**
+ * Replays the trace into the engine and compares the strokes
+ * with the expected ones.
+ */
+static int check(const char* name, StenoEngine& engine, const Trace& trace,
+    const std::vector<TraceStroke>& expected) {
+  const std::vector<TraceStroke> strokes = replayTrace(engine, trace);
+  boolean isOk = strokes.size() == expected.size();
+  for (size_t i = 0; isOk && i < strokes.size(); i++) {
+    isOk = strokes[i].keys == expected[i].keys;
+  }
+  printf("%s: %d strokes:", name, (int) strokes.size());
+  for (size_t i = 0; i < strokes.size(); i++) {
+    printf(" [%s]", traceKeysToString(strokes[i].keys).c_str());
+    if (isOk) {
+      printf(" +%ldus", (long) (strokes[i].micros - expected[i].micros));
+    }
+  }
+  printf(" -> %s\n", isOk ? "ok" : "FAILED");
+  return isOk ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  const char* directory = argc > 1 ? argv[1] : "traces";
+  std::vector<Trace> traces;
+  if (!loadTraces(directory, traces) || traces.empty()) {
+    fprintf(stderr, "%s: no usable traces\n", directory);
+    return 1;
+  }
+
+  int failures = 0;
+  for (size_t i = 0; i < traces.size(); i++) {
+    StenoEngine engine;
+    failures += check(traces[i].name.c_str(), engine, traces[i], traces[i].strokes);
+  }
+
+  // Longer debounce and no splitting: the tap is ignored, the rollover merged
+  for (size_t i = 0; i < traces.size(); i++) {
+    if (traces[i].name == "tap_and_rollover.trace") {
+      StenoEngine merging;
+      merging.debounceMillis = 40;
+      merging.rolloverSplitting = false;
+      const TraceStroke merged = {320000,
+          traceKeyBit("T") | traceKeyBit("P") | traceKeyBit("p") | traceKeyBit("l")};
+      failures += check("merging", merging, traces[i], std::vector<TraceStroke>(1, merged));
+    }
+  }
+  return failures;
+}
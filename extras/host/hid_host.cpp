@@ -0,0 +1,137 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Runs HidReportScheduler on a mocked frame clock and time source,
+ * and checks the order of the sent reports, that there is at most one
+ * report per frame, that a queued report goes out every frame, and that
+ * two strokes with every key pressed fit in the queue.
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "Keyboard.h"
+#include "StenoboardKeyboardDefinition.h"
+#include "HidReportScheduler.h"
+
+Keyboard_ Keyboard;
+
+static unsigned long mockMicros;
+
+static unsigned long mockClock() {
+  return mockMicros;
+}
+
+static byte mockFrameClock() {
+  return (byte) (mockMicros / 1000);
+}
+
+static unsigned long sentStrokes[4];
+static byte sentStrokeFrames[4];
+static int sentStrokeCount;
+
+static void strokeSent(const unsigned long strokeMicros) {
+  if (sentStrokeCount < 4) {
+    sentStrokes[sentStrokeCount] = strokeMicros;
+    sentStrokeFrames[sentStrokeCount] = mockFrameClock();
+    sentStrokeCount++;
+  }
+}
+
+static int check(const char* name, const boolean isOk) {
+  printf("%s -> %s\n", name, isOk ? "ok" : "FAILED");
+  return isOk ? 0 : 1;
+}
+
+int main() {
+  Keyboard.frameClock = mockFrameClock;
+  HidReportScheduler reports(mockFrameClock, mockClock);
+  reports.setStrokeSentListener(strokeSent);
+
+  // Two strokes queued 100 us apart, in the middle of a frame
+  mockMicros = 5500;
+  reports.press('s');
+  reports.press('t');
+  reports.press('k');
+  reports.releaseAll();
+  reports.endStroke(5400);
+  mockMicros += 100;
+  reports.press('p');
+  reports.releaseAll();
+  reports.endStroke(5500);
+
+  // Update faster than the frames, as the main loop does
+  for (; mockMicros < 20000; mockMicros += 100) {
+    reports.update();
+  }
+
+  const Keyboard_::Report expected[] = {
+    {true, 's', 0}, {true, 't', 0}, {true, 'k', 0}, {false, 0, 0},
+    {true, 'p', 0}, {false, 0, 0},
+  };
+  const int expectedCount = sizeof(expected) / sizeof(expected[0]);
+
+  boolean isInOrder = Keyboard.logSize == expectedCount;
+  for (int i = 0; isInOrder && i < expectedCount; i++) {
+    isInOrder = Keyboard.log[i].isPress == expected[i].isPress
+        && Keyboard.log[i].key == expected[i].key;
+  }
+  // The first report goes out right away, then one per frame
+  boolean isOnePerFrame = Keyboard.logSize > 0 && Keyboard.log[0].frame == 5;
+  for (int i = 1; isOnePerFrame && i < Keyboard.logSize; i++) {
+    isOnePerFrame = Keyboard.log[i].frame == (byte) (Keyboard.log[i - 1].frame + 1);
+  }
+  const boolean isStrokeSentAtLastReport = sentStrokeCount == 2
+      && sentStrokes[0] == 5400 && sentStrokeFrames[0] == Keyboard.log[3].frame
+      && sentStrokes[1] == 5500 && sentStrokeFrames[1] == Keyboard.log[5].frame;
+  const boolean isCounted = reports.sentReports == (unsigned long) expectedCount
+      && reports.overflows == 0 && reports.maxDelayMicros < expectedCount * 1000U;
+
+  int failures = 0;
+  failures += check("report order", isInOrder);
+  failures += check("one report per frame", isOnePerFrame);
+  failures += check("stroke sent with its last report", isStrokeSentAtLastReport);
+  failures += check("report stats", isCounted);
+
+  // Two strokes of the most reports a protocol sends, queued at once
+  Keyboard.logSize = 0;
+  reports.resetStats();
+  const int strokeReports = 2 * ROWS * COLS + 2;
+  for (int stroke = 0; stroke < 2; stroke++) {
+    for (int key = 0; key < ROWS * COLS; key++) {
+      reports.press('a' + key);
+    }
+    for (int key = 0; key < ROWS * COLS; key++) {
+      reports.release('a' + key);
+    }
+    reports.releaseAll();
+    reports.releaseAll();
+    reports.endStroke(mockMicros);
+  }
+  for (const unsigned long endMicros = mockMicros + 200000; mockMicros < endMicros; mockMicros += 100) {
+    reports.update();
+  }
+  boolean isSpread = Keyboard.logSize == 2 * strokeReports;
+  for (int i = 1; isSpread && i < Keyboard.logSize; i++) {
+    isSpread = Keyboard.log[i].frame == (byte) (Keyboard.log[i - 1].frame + 1);
+  }
+  failures += check("two full strokes without overflow", isSpread && reports.overflows == 0
+      && reports.sentReports == 2UL * strokeReports);
+  return failures;
+}
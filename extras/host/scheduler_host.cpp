@@ -0,0 +1,135 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Runs the Scheduler on a virtual clock, with busy tasks that advance
+ * the clock by their run time, and key scans interleaved like loop() does.
+ * Reports the scan to scan jitter and the overruns per task, once with
+ * the firmware's light tasks and once under full load, and checks that
+ * the time between two scans stays within the scan interval plus the
+ * longest task run, as the scheduler promises.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "Arduino.h"
+#include "Scheduler.h"
+
+/** Time a key matrix scan takes, including the row settle delays */
+#define SCAN_COST_MICROS 120UL
+/** Minimum time between two scans, see scanIntervalMicros in the firmware */
+#define SCAN_INTERVAL_MICROS 1000UL
+/** Time one iteration of loop() takes besides the scan and the task */
+#define LOOP_COST_MICROS 8UL
+#define SIMULATED_MICROS 2000000UL
+
+static unsigned long virtualMicros;
+
+static unsigned long virtualClock() {
+  return virtualMicros;
+}
+
+// Busy tasks, each taking a fixed time
+static void output() { virtualMicros += 150; }
+static void commands() { virtualMicros += 40; }
+static void ledEffect() { virtualMicros += 300; }
+static void macroPlayback() { virtualMicros += 450; }
+static void eepromFlush() { virtualMicros += 900; }
+
+static const char* const taskNames[] = {"output", "commands", "led", "macros", "eeprom"};
+
+/** The tasks of the firmware */
+static const Task lightTasks[] = {
+  // function, period, deadline (micros), priority
+  {output, 1000, 1000, 0},
+  {commands, 200, 1000, 1},
+};
+
+/** The firmware tasks and the kinds of work the scheduler is meant for */
+static const Task fullLoadTasks[] = {
+  // function, period, deadline (micros), priority
+  {output, 1000, 1000, 0},
+  {commands, 200, 1000, 1},
+  {ledEffect, 2000, 2000, 2},
+  {macroPlayback, 1000, 3000, 3},
+  {eepromFlush, 10000, 20000, 4},
+};
+
+static int simulate(const char* name, const Task* tasks, const int taskCount) {
+  TaskState states[8];
+  virtualMicros = 0;
+  Scheduler scheduler(tasks, states, taskCount, virtualClock);
+  scheduler.begin();
+
+  unsigned long longestRunMicros = 0;
+  unsigned long lastScanMicros = 0;
+  boolean hasScanned = false;
+  unsigned long scans = 0;
+  unsigned long minGapMicros = 0xFFFFFFFFUL;
+  unsigned long maxGapMicros = 0;
+  double gapSum = 0;
+  double gapSquareSum = 0;
+  while (virtualMicros < SIMULATED_MICROS) {
+    // As in loop()
+    if (!hasScanned || virtualMicros - lastScanMicros >= SCAN_INTERVAL_MICROS) {
+      if (hasScanned) {
+        const unsigned long gapMicros = virtualMicros - lastScanMicros;
+        minGapMicros = gapMicros < minGapMicros ? gapMicros : minGapMicros;
+        maxGapMicros = gapMicros > maxGapMicros ? gapMicros : maxGapMicros;
+        gapSum += gapMicros;
+        gapSquareSum += (double) gapMicros * gapMicros;
+        scans++;
+      }
+      lastScanMicros = virtualMicros;
+      hasScanned = true;
+      virtualMicros += SCAN_COST_MICROS;
+    }
+    const unsigned long runStartMicros = virtualMicros;
+    scheduler.runNext();
+    if (virtualMicros - runStartMicros > longestRunMicros) {
+      longestRunMicros = virtualMicros - runStartMicros;
+    }
+    virtualMicros += LOOP_COST_MICROS;
+  }
+
+  const double meanGapMicros = gapSum / scans;
+  const double variance = gapSquareSum / scans - meanGapMicros * meanGapMicros;
+  const double deviation = variance > 0 ? sqrt(variance) : 0;
+  printf("%s: %lu scans every %lu us: mean %.1f, min %lu, max %lu, jitter (std dev) %.1f us\n",
+      name, scans, SCAN_INTERVAL_MICROS, meanGapMicros, minGapMicros, maxGapMicros, deviation);
+  for (int i = 0; i < scheduler.getTaskCount(); i++) {
+    const TaskState& state = scheduler.getTaskState(i);
+    printf("  %-8s runs %6lu, overruns %5u, longest run %lu us\n",
+        taskNames[i], state.runs, state.overruns, state.maxRunMicros);
+  }
+
+  // A scan is held back at most by an iteration that started just before it was due
+  const unsigned long boundMicros = SCAN_INTERVAL_MICROS + longestRunMicros + LOOP_COST_MICROS;
+  const boolean isOk = maxGapMicros <= boundMicros;
+  printf("  longest scan gap %lu us, bound %lu us -> %s\n",
+      maxGapMicros, boundMicros, isOk ? "ok" : "FAILED");
+  return isOk ? 0 : 1;
+}
+
+int main() {
+  int failures = 0;
+  failures += simulate("firmware tasks", lightTasks, sizeof(lightTasks) / sizeof(lightTasks[0]));
+  failures += simulate("full load", fullLoadTasks, sizeof(fullLoadTasks) / sizeof(fullLoadTasks[0]));
+  return failures;
+}
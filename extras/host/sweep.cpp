@@ -0,0 +1,225 @@
+/*
+   StenoFW is a firmware for Stenoboard keyboards.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   Copyright 2017 Emanuele Caruso. See the LICENSE file for details.
+ */
+
+/*
+ * Sweeps the chord engine settings over a corpus of recorded traces
+ * (see StrokeTrace.h), and ranks the settings by misstroke rate,
+ * then by mean and then by 99th percentile stroke latency.
+ *
+ * Every setting of the grid gets its own StenoEngine per trace, and the
+ * settings are spread over a thread pool with one thread per core.
+ *
+ * A misstroke is an expected stroke that was not written as such, or an
+ * extra stroke: the edit distance between the written and the expected
+ * stroke sequence. The latency of a correctly written stroke is the time
+ * from when the writer completed it until StenoEngine::strokeMicros.
+ *
+ * Usage: sweep [trace directory] [number of settings to print]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "StrokeTrace.h"
+
+/** First, last and step value of a swept setting */
+struct SweepRange {
+  long first;
+  long last;
+  long step;
+};
+
+static const SweepRange debounceRange = {0, 40, 2};
+static const SweepRange rolloverMinGapRange = {0, 20, 1};
+static const SweepRange rolloverMinPressRange = {0, 40, 5};
+
+struct SweepConfig {
+  long debounceMillis;
+  boolean rolloverSplitting;
+  long rolloverMinGapMillis;
+  long rolloverMinPressMillis;
+};
+
+struct SweepResult {
+  SweepConfig config;
+  int misstrokes;
+  int expectedStrokes;
+  double meanLatencyMicros;
+  long p99LatencyMicros;
+
+  double misstrokeRate() const {
+    return expectedStrokes > 0 ? (double) misstrokes / expectedStrokes : 0;
+  }
+};
+
+/**
+ * Builds the grid of all settings. Without splitting the rollover
+ * thresholds have no effect, so those settings are only swept once.
+ */
+static std::vector<SweepConfig> buildGrid() {
+  std::vector<SweepConfig> grid;
+  for (long debounce = debounceRange.first; debounce <= debounceRange.last;
+      debounce += debounceRange.step) {
+    SweepConfig merging = {debounce, false, ::rolloverMinGapMillis, ::rolloverMinPressMillis};
+    grid.push_back(merging);
+    for (long gap = rolloverMinGapRange.first; gap <= rolloverMinGapRange.last;
+        gap += rolloverMinGapRange.step) {
+      for (long press = rolloverMinPressRange.first; press <= rolloverMinPressRange.last;
+          press += rolloverMinPressRange.step) {
+        SweepConfig splitting = {debounce, true, gap, press};
+        grid.push_back(splitting);
+      }
+    }
+  }
+  return grid;
+}
+
+/**
+ * Aligns the written strokes with the expected ones by edit distance,
+ * adding the latencies of the correctly written strokes.
+ * @return the edit distance
+ */
+static int alignStrokes(const std::vector<TraceStroke>& written,
+    const std::vector<TraceStroke>& expected, std::vector<long>& latencies) {
+  const size_t rows = written.size() + 1;
+  const size_t columns = expected.size() + 1;
+  std::vector<int> distance(rows * columns);
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = 0; j < columns; j++) {
+      if (i == 0 || j == 0) {
+        distance[i * columns + j] = (int) (i + j);
+        continue;
+      }
+      const int substitution = written[i - 1].keys == expected[j - 1].keys ? 0 : 1;
+      distance[i * columns + j] = std::min(distance[(i - 1) * columns + j - 1] + substitution,
+          std::min(distance[(i - 1) * columns + j], distance[i * columns + j - 1]) + 1);
+    }
+  }
+  size_t i = rows - 1;
+  size_t j = columns - 1;
+  while (i > 0 && j > 0) {
+    const boolean isMatch = written[i - 1].keys == expected[j - 1].keys;
+    if (distance[i * columns + j] == distance[(i - 1) * columns + j - 1] + (isMatch ? 0 : 1)) {
+      if (isMatch) {
+        latencies.push_back((long) (written[i - 1].micros - expected[j - 1].micros));
+      }
+      i--;
+      j--;
+    } else if (distance[i * columns + j] == distance[(i - 1) * columns + j] + 1) {
+      i--;
+    } else {
+      j--;
+    }
+  }
+  return distance[rows * columns - 1];
+}
+
+static SweepResult evaluate(const SweepConfig& config, const std::vector<Trace>& traces) {
+  SweepResult result = {config, 0, 0, 0, 0};
+  std::vector<long> latencies;
+  for (size_t i = 0; i < traces.size(); i++) {
+    StenoEngine engine;
+    engine.debounceMillis = config.debounceMillis;
+    engine.rolloverSplitting = config.rolloverSplitting;
+    engine.rolloverMinGapMillis = config.rolloverMinGapMillis;
+    engine.rolloverMinPressMillis = config.rolloverMinPressMillis;
+    result.misstrokes += alignStrokes(replayTrace(engine, traces[i]), traces[i].strokes, latencies);
+    result.expectedStrokes += (int) traces[i].strokes.size();
+  }
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (size_t i = 0; i < latencies.size(); i++) {
+      sum += latencies[i];
+    }
+    result.meanLatencyMicros = sum / latencies.size();
+    result.p99LatencyMicros = latencies[(latencies.size() * 99 + 99) / 100 - 1];
+  }
+  return result;
+}
+
+static boolean isRankedBefore(const SweepResult& a, const SweepResult& b) {
+  if (a.misstrokeRate() != b.misstrokeRate()) {
+    return a.misstrokeRate() < b.misstrokeRate();
+  }
+  if (a.meanLatencyMicros != b.meanLatencyMicros) {
+    return a.meanLatencyMicros < b.meanLatencyMicros;
+  }
+  return a.p99LatencyMicros < b.p99LatencyMicros;
+}
+
+static void printResult(const int rank, const SweepResult& result) {
+  const SweepConfig& config = result.config;
+  printf("%5d %8ld %9s ", rank, config.debounceMillis, config.rolloverSplitting ? "split" : "merge");
+  if (config.rolloverSplitting) {
+    printf("%6ld %8ld", config.rolloverMinGapMillis, config.rolloverMinPressMillis);
+  } else {
+    printf("%6s %8s", "-", "-");
+  }
+  printf(" %9.1f%% %9.1f %9.1f\n", 100 * result.misstrokeRate(),
+      result.meanLatencyMicros / 1000, result.p99LatencyMicros / 1000.0);
+}
+
+int main(int argc, char** argv) {
+  const char* directory = argc > 1 ? argv[1] : "traces";
+  const int printCount = argc > 2 ? atoi(argv[2]) : 10;
+  std::vector<Trace> traces;
+  if (!loadTraces(directory, traces) || traces.empty()) {
+    fprintf(stderr, "%s: no usable traces\n", directory);
+    return 1;
+  }
+
+  const std::vector<SweepConfig> grid = buildGrid();
+  std::vector<SweepResult> results(grid.size());
+  std::atomic<size_t> nextConfig(0);
+  const unsigned int threadCount = std::max(1U, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < threadCount; i++) {
+    threads.push_back(std::thread([&]() {
+      for (size_t config; (config = nextConfig++) < grid.size(); ) {
+        results[config] = evaluate(grid[config], traces);
+      }
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  std::stable_sort(results.begin(), results.end(), isRankedBefore);
+
+  printf("%d settings on %d traces with %d threads\n",
+      (int) results.size(), (int) traces.size(), threadCount);
+  printf("%5s %8s %9s %6s %8s %10s %9s %9s\n", "rank", "debounce", "rollover",
+      "gap", "minPress", "misstrokes", "mean ms", "p99 ms");
+  for (int i = 0; i < printCount && i < (int) results.size(); i++) {
+    printResult(i + 1, results[i]);
+  }
+  for (size_t i = 0; i < results.size(); i++) {
+    const SweepConfig& config = results[i].config;
+    if (config.debounceMillis == ::debounceMillis && config.rolloverSplitting == ::rolloverSplitting
+        && config.rolloverMinGapMillis == ::rolloverMinGapMillis
+        && config.rolloverMinPressMillis == ::rolloverMinPressMillis) {
+      printf("firmware defaults:\n");
+      printResult((int) i + 1, results[i]);
+    }
+  }
+  return 0;
+}